@@ -0,0 +1,357 @@
+/*
+ * Practical cube-attack against nonce-misused ASCON
+ * Filename : anf.hpp
+ * Content : Algebraic normal form of the coordinates of the ASCON state, shared
+ *           by phases 2 and 3: monomials, coordinates as sets of monomials,
+ *           their additions and multiplications, and their compressed form.
+*/
+
+#ifndef ANF_HPP
+#define ANF_HPP
+
+#include <iostream>
+#include <string>
+#include <set>
+#include <array>
+#include <vector>
+#include <bitset>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <utility>
+#include <omp.h>
+
+// a monomial represented as a boolean vector of size 320
+// (words 0 to 3 hold the v_i, a_i, b_i and c_i, word 4 the e_i when they are
+// kept symbolic)
+using monom = std::array<uint64_t, 5>;
+
+// a coordinate is seen as a set of monomials
+using coor = std::set<monom>;
+
+// ASCON state made of 320 coordinates
+using state = std::array<coor, 320>;
+
+using uint = unsigned int;
+
+// set of coordinates of a state, used to only compute some of them
+using coor_mask = std::bitset<320>;
+
+// coordinate compressed as a byte string of delta-encoded varints (see pack_coor)
+using packed_coor = std::vector<uint8_t>;
+using packed_state = std::array<packed_coor, 320>;
+
+// set of degrees in v_i (at most 63), bit d standing for degree d
+using degree_set = uint64_t;
+
+inline constexpr degree_set all_degrees = ~((degree_set) 0);
+
+constexpr degree_set degrees(std::initializer_list<uint> degs) {
+	degree_set s = 0;
+	for(const auto &d: degs)
+		s |= ((degree_set) 1) << d;
+	return s;
+}
+
+
+/*
+ * Filter of the products computed by mult_coor: only the monomials whose
+ * degree in v_i is in degs are kept.
+ */
+struct degree_filter {
+	degree_set degs;
+
+	bool operator()(const monom &m) const {
+		const uint d = __builtin_popcountll(m[0]);
+		return d < 64 && ((degs >> d) & 1);
+	}
+};
+
+// Filter keeping every product
+struct no_filter {
+	bool operator()(const monom &) const {
+		return true;
+	}
+};
+
+
+/*
+ * Fused k-way addition (symmetric difference) of sorted ranges of monomials.
+ * Each range is expected to be sorted and without repetition. All ranges are
+ * streamed once, and each monomial appearing an odd number of times is written
+ * to out, in increasing order. No intermediate sum is ever materialized.
+ * The smallest head is found by a scan of the k heads: with k <= 7 (S-box),
+ * it stays faster than a heap of the ranges.
+ */
+template<typename It, typename Out>
+Out xor_merge(std::vector<std::pair<It, It>> ranges, Out out) {
+	while(true) {
+		// Smallest head among the non-exhausted ranges
+		const monom *smallest = nullptr;
+		for(const auto &[first, last]: ranges) {
+			if(first != last && (smallest == nullptr || *first < *smallest))
+				smallest = &(*first);
+		}
+		if(smallest == nullptr)
+			return out;
+
+		// Counts its occurrences (at most once per range) and skips them
+		const monom m = *smallest;
+		bool odd = false;
+		for(auto &[first, last]: ranges) {
+			if(first != last && *first == m) {
+				odd = !odd;
+				++first;
+			}
+		}
+		if(odd)
+			*out++ = m;
+	}
+}
+
+
+/*
+ *  Computes the addition of several coordinates in a single pass and writes it
+ *  directly into dest. dest must not be one of the terms.
+ */
+inline void add_coors(std::initializer_list<const coor *> terms, coor &dest) {
+	std::vector<std::pair<coor::const_iterator, coor::const_iterator>> ranges;
+	ranges.reserve(terms.size());
+	for(const coor *t: terms)
+		ranges.emplace_back(t->begin(), t->end());
+
+	dest.clear();
+	// The output is sorted, so the end of dest is always the right hint
+	xor_merge(ranges, std::inserter(dest, dest.end()));
+}
+
+
+/*
+ *  Returns the addition of two coordinates.
+ */
+inline const coor add_coor(const coor &c1, const coor &c2) {
+	coor c;
+	add_coors({&c1, &c2}, c);
+	return c;
+}
+
+
+/*
+ * Returns the product of a monomial/monomial multiplication
+ */
+inline const monom mult_monom(const monom &m1, const monom &m2) {
+	monom m = {0, 0, 0, 0, 0};
+	for(uint i = 0; i < 5; i++)
+		m[i] = m1[i] | m2[i];
+	return m;
+}
+
+
+/*
+ * Returns the product of a coordinate/coordinate multiplication.
+ * The parameter condition_mult is a function  f: monomial -> Boolean
+ * It is used to filter the resulting product: once the product of two monomials
+ * is computed, we check if it is interesting or not for the next steps
+ * (i.e. f(m1*m2) = true/false). All products of present monomials are computed
+ *  during the multiplication of coordinates BUT only the interesting ones are
+ *  stored in the resulting product.
+ * The filter is a template parameter, so that it is inlined in the loop.
+ */
+template<typename filter_t>
+const coor mult_coor(const coor &c1, const coor &c2, const filter_t &condition_mult) {
+	coor c;
+	for(const auto &x: c1) {
+		for(const auto &y: c2) {
+			const monom m = mult_monom(x, y);
+			if(condition_mult(m)) {
+				// Handles the XOR cancellation if the monomial is already present.
+				if(c.contains(m))
+					c.erase(m);
+				else
+					c.insert(m);
+			}
+		}
+	}
+	return c;
+}
+
+
+/*
+ * For each row of the state s, prints the average length of a coordinate
+ */
+inline void print_len(const state &s, const std::string &name) {
+	std::cout << name << " avg: ";
+	for(uint i = 0; i < 5; i++) {
+		uint mean = 0;
+		for(uint j = 0; j < 64; j++) {
+			mean += s[i * 64 + j].size();
+		}
+		std::cout << std::to_string(static_cast<int>(((float) mean) / 64)) + " | ";
+	}
+	std::cout << std::endl;
+}
+
+
+/*
+ * Estimated memory used by a coordinate stored as a std::set: each monomial
+ * lives in its own tree node.
+ */
+inline size_t coor_bytes(const coor &c) {
+	return c.size() * (sizeof(monom) + 32);
+}
+
+
+inline size_t state_bytes(const state &s) {
+	size_t bytes = 0;
+	for(const auto &c: s)
+		bytes += coor_bytes(c);
+	return bytes;
+}
+
+
+/*
+ * Appends x to p as a varint: 7 bits per byte, the highest bit of a byte
+ * being set when more bytes follow.
+ */
+inline void put_varint(packed_coor &p, uint64_t x) {
+	while(x >= 0x80) {
+		p.push_back((uint8_t) ((x & 0x7f) | 0x80));
+		x >>= 7;
+	}
+	p.push_back((uint8_t) x);
+}
+
+
+inline uint64_t get_varint(const uint8_t *&it) {
+	uint64_t x = 0;
+	for(uint shift = 0; ; shift += 7) {
+		const uint8_t byte = *(it++);
+		x |= ((uint64_t) (byte & 0x7f)) << shift;
+		if(!(byte & 0x80))
+			return x;
+	}
+}
+
+
+/*
+ * Compresses a coordinate into a byte string: the number of monomials, then
+ * for each monomial (in increasing order) the index k of the first word which
+ * differs from the previous monomial, the difference on word k (positive as
+ * monomials are sorted), and the following words. All of them are varints.
+ */
+inline packed_coor pack_coor(const coor &c) {
+	packed_coor p;
+	put_varint(p, c.size());
+	monom prev = {0, 0, 0, 0, 0};
+	for(const auto &m: c) {
+		uint k = 0;
+		while(k < 5 && m[k] == prev[k])
+			k++;
+		p.push_back((uint8_t) k);
+		if(k < 5) {
+			put_varint(p, m[k] - prev[k]);
+			for(uint j = k + 1; j < 5; j++)
+				put_varint(p, m[j]);
+		}
+		prev = m;
+	}
+	p.shrink_to_fit();
+	return p;
+}
+
+
+/*
+ * Reads a coordinate compressed by pack_coor starting at it, and moves it past
+ * the coordinate.
+ */
+inline coor unpack_coor(const uint8_t *&it) {
+	coor c;
+	const uint64_t size = get_varint(it);
+	monom m = {0, 0, 0, 0, 0};
+	for(uint64_t i = 0; i < size; i++) {
+		const uint k = *(it++);
+		if(k < 5) {
+			m[k] += get_varint(it);
+			for(uint j = k + 1; j < 5; j++)
+				m[j] = get_varint(it);
+		}
+		c.emplace_hint(c.end(), m);
+	}
+	return c;
+}
+
+
+inline coor unpack_coor(const packed_coor &p) {
+	const uint8_t *it = p.data();
+	return unpack_coor(it);
+}
+
+
+/*
+ * Compresses the coordinates in mask of s, and releases them from s.
+ * Returns the memory saved, or 0 if the packed coordinates are larger (e.g.
+ * when they are all empty, an empty coordinate still taking one byte).
+ */
+inline size_t pack_state(state &s, const coor_mask &mask, packed_state &packed) {
+	std::vector<int64_t> saved(320, 0);
+#pragma omp parallel for default(none) shared(s, mask, packed, saved)
+	for(uint i = 0; i < 320; i++) {
+		if(mask[i]) {
+			packed[i] = pack_coor(s[i]);
+			saved[i] = (int64_t) coor_bytes(s[i]) - (int64_t) packed[i].capacity();
+			coor().swap(s[i]);
+		}
+	}
+	int64_t total = 0;
+	for(const auto &x: saved)
+		total += x;
+	return (total > 0) ? total : 0;
+}
+
+
+/*
+ * Returns a state holding the decompressed coordinates in mask of packed.
+ */
+inline state unpack_state(const packed_state &packed, const coor_mask &mask) {
+	state s;
+#pragma omp parallel for default(none) shared(s, mask, packed)
+	for(uint i = 0; i < 320; i++) {
+		if(mask[i])
+			s[i] = unpack_coor(packed[i]);
+	}
+	return s;
+}
+
+
+/*
+ * Concatenation of the coordinates of s compressed by pack_coor, which
+ * identifies s (e.g. to name a cache file after it).
+ */
+inline packed_coor serialize_state(const state &s) {
+	packed_coor bytes;
+	for(const auto &c: s) {
+		const packed_coor p = pack_coor(c);
+		bytes.insert(bytes.end(), p.begin(), p.end());
+	}
+	return bytes;
+}
+
+
+/*
+ * 64-bit FNV-1a hash of bytes with an initial value depending on seed,
+ * followed by a final mix so that all the bits of the key depend on all the
+ * bytes.
+ */
+inline uint64_t state_key(const packed_coor &bytes, const uint64_t &seed) {
+	uint64_t h = 0xcbf29ce484222325ULL ^ seed;
+	for(const auto &b: bytes) {
+		h ^= b;
+		h *= 0x100000001b3ULL;
+	}
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return h;
+}
+
+#endif /* ANF_HPP */
@@ -0,0 +1,96 @@
+/*
+ * Practical cube-attack against nonce-misused ASCON
+ * Filename : bloom_filter.hpp
+ * Content : Approximate membership filter on the monomials of a polynomial in
+ *           v_i, used to skip the lookups of S6 which cannot succeed.
+*/
+
+#ifndef BLOOM_FILTER_HPP
+#define BLOOM_FILTER_HPP
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+/*
+ * Blocked Bloom filter: a monomial sets 4 bits of a single block of 512 bits,
+ * i.e. one cache line, chosen by the high bits of its hash, the 4 bits being
+ * taken from the low bits. With at least 10 bits per monomial, less than 2% of
+ * the absent monomials pass the filter.
+ * A filter without any block lets every monomial pass.
+ */
+class bloom_filter {
+public:
+	bloom_filter() = default;
+
+	// Filter sized for n monomials
+	explicit bloom_filter(const size_t &n) {
+		const size_t nb_blocks = blocks_for(n);
+		blocks.resize(nb_blocks);
+		shift = 64 - __builtin_ctzll(nb_blocks);
+	}
+
+	// Bytes taken by a filter sized for n monomials
+	static size_t bytes_for(const size_t &n) {
+		return blocks_for(n) * sizeof(block);
+	}
+
+	void insert(const uint64_t &m) {
+		const uint64_t h = hash(m);
+		block &b = blocks[block_index(h)];
+		for(unsigned int i = 0; i < nb_bits; i++) {
+			const unsigned int bit = (h >> (9 * i)) & (block_bits - 1);
+			b[bit / 64] |= ((uint64_t) 1) << (bit % 64);
+		}
+	}
+
+	// False only if m was not inserted
+	bool might_contain(const uint64_t &m) const {
+		if(blocks.empty())
+			return true;
+		const uint64_t h = hash(m);
+		const block &b = blocks[block_index(h)];
+		for(unsigned int i = 0; i < nb_bits; i++) {
+			const unsigned int bit = (h >> (9 * i)) & (block_bits - 1);
+			if(!((b[bit / 64] >> (bit % 64)) & 1))
+				return false;
+		}
+		return true;
+	}
+
+	size_t bytes() const {
+		return blocks.size() * sizeof(block);
+	}
+
+private:
+	static constexpr size_t block_bits = 512;
+	static constexpr size_t bits_per_monom = 10;
+	static constexpr unsigned int nb_bits = 4;
+
+	struct alignas(64) block : std::array<uint64_t, 8> {};
+
+	std::vector<block> blocks; // Power of 2 number of blocks
+	unsigned int shift = 64;
+
+	static size_t blocks_for(const size_t &n) {
+		size_t nb_blocks = 1;
+		while(nb_blocks * block_bits < bits_per_monom * n)
+			nb_blocks *= 2;
+		return nb_blocks;
+	}
+
+	// Finalizer of MurmurHash3: every bit of the hash depends on every bit of m
+	static uint64_t hash(uint64_t m) {
+		m ^= m >> 33;
+		m *= 0xff51afd7ed558ccdULL;
+		m ^= m >> 33;
+		m *= 0xc4ceb9fe1a85ec53ULL;
+		return m ^ (m >> 33);
+	}
+
+	size_t block_index(const uint64_t &h) const {
+		return (shift == 64) ? 0 : (h >> shift);
+	}
+};
+
+#endif /* BLOOM_FILTER_HPP */
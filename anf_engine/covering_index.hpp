@@ -0,0 +1,80 @@
+/*
+ * Practical cube-attack against nonce-misused ASCON
+ * Filename : covering_index.hpp
+ * Content : Index of the monomials of a polynomial in v_i by the monomials
+ *           they cover, i.e. those with one variable less, used by S6 to find
+ *           the terms which overlap a given one in a single variable.
+*/
+
+#ifndef COVERING_INDEX_HPP
+#define COVERING_INDEX_HPP
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "dense_layer.hpp"
+
+/*
+ * For each monomial m of degree min_degree to max_degree of a polynomial in
+ * the variables of vars, and each variable v of m, an entry {m / v, m}. Both
+ * monomials are compressed to the variables of vars (see compress_monom) and
+ * packed in a single word, the entries being sorted: the monomials covering a
+ * given one are consecutive.
+ * A polynomial in more than 32 variables is not indexed.
+ */
+class covering_index {
+public:
+	covering_index() = default;
+
+	template<typename poly_t>
+	covering_index(const poly_t &p, const uint64_t &vars, const unsigned int &min_degree, const unsigned int &max_degree) : vars(vars) {
+		if(__builtin_popcountll(vars) > 32)
+			return;
+		p.for_each([&](const uint64_t &monom, const auto &) {
+			const unsigned int d = __builtin_popcountll(monom);
+			if(d < min_degree || d > max_degree || (monom & ~vars))
+				return;
+			const uint64_t c = compress_monom(monom, vars);
+			for(uint64_t rest = c; rest; rest &= (rest - 1))
+				entries.push_back(((c ^ (rest & (~rest + 1))) << 32) | c);
+		});
+		std::sort(entries.begin(), entries.end());
+	}
+
+	bool empty() const {
+		return entries.empty();
+	}
+
+	size_t bytes() const {
+		return entries.size() * sizeof(uint64_t);
+	}
+
+	/*
+	 * Calls f(q, m) on the queries q of [q, q_end), sorted by their first
+	 * member (a monomial in the variables of vars), and the monomials m of the
+	 * index which cover them. As in merge_terms (see rounds_5_6.hpp), the index
+	 * is walked once, by steps doubling in size from one query to the next.
+	 */
+	template<typename query_t, typename F>
+	void for_each_cover(const query_t *q, const query_t *q_end, F f) const {
+		size_t j = 0;
+		const size_t n = entries.size();
+		for(; q != q_end && j < n; q++) {
+			const uint64_t low = compress_monom(q->first, vars) << 32;
+			if(entries[j] < low) {
+				size_t step = 1;
+				while(j + step < n && entries[j + step] < low)
+					step *= 2;
+				j = std::lower_bound(entries.begin() + j + step / 2 + 1, entries.begin() + std::min(j + step, n), low) - entries.begin();
+			}
+			for(size_t i = j; i < n && (entries[i] >> 32) == (low >> 32); i++)
+				f(*q, deposit_monom(entries[i] & 0xffffffff, vars));
+		}
+	}
+
+private:
+	uint64_t vars = 0;
+	std::vector<uint64_t> entries;
+};
+
+#endif /* COVERING_INDEX_HPP */
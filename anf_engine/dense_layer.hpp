@@ -0,0 +1,370 @@
+/*
+ * Practical cube-attack against nonce-misused ASCON
+ * Filename : dense_layer.hpp
+ * Content : Dense storage of polynomials in v_i whose monomials all have the
+ *           same degree. Monomials are indexed by their rank in the
+ *           combinatorial number system, which turns membership tests and
+ *           lookups into array accesses.
+*/
+
+#ifndef DENSE_LAYER_HPP
+#define DENSE_LAYER_HPP
+
+#include <array>
+#include <vector>
+#include <map>
+#include <span>
+#include <cstdint>
+#include <algorithm>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+#include "bloom_filter.hpp"
+
+/*
+ * Table of binomial coefficients C(n, k) for 0 <= k <= n <= 64.
+ */
+constexpr std::array<std::array<uint64_t, 65>, 65> binomial_table() {
+	std::array<std::array<uint64_t, 65>, 65> c = {};
+	for(unsigned int n = 0; n <= 64; n++) {
+		c[n][0] = 1;
+		for(unsigned int k = 1; k <= n; k++)
+			c[n][k] = c[n - 1][k - 1] + c[n - 1][k];
+	}
+	return c;
+}
+inline constexpr std::array<std::array<uint64_t, 65>, 65> binomial = binomial_table();
+
+
+/*
+ * Extracts the bits of m selected by vars and packs them in the lowest bits.
+ */
+inline uint64_t compress_monom(const uint64_t &m, const uint64_t &vars) {
+#ifdef __BMI2__
+	return _pext_u64(m, vars);
+#else
+	uint64_t c = 0;
+	uint64_t v = vars;
+	for(unsigned int i = 0; v; i++) {
+		const uint64_t low = v & (~v + 1);
+		if(m & low)
+			c |= ((uint64_t) 1) << i;
+		v ^= low;
+	}
+	return c;
+#endif
+}
+
+
+/*
+ * Inverse of compress_monom: spreads the lowest bits of c over the bits of vars.
+ */
+inline uint64_t deposit_monom(const uint64_t &c, const uint64_t &vars) {
+#ifdef __BMI2__
+	return _pdep_u64(c, vars);
+#else
+	uint64_t m = 0;
+	uint64_t v = vars;
+	for(unsigned int i = 0; v; i++) {
+		const uint64_t low = v & (~v + 1);
+		if((c >> i) & 1)
+			m |= low;
+		v ^= low;
+	}
+	return m;
+#endif
+}
+
+
+/*
+ * Next word with the same number of bits set, in increasing order (Gosper's
+ * hack). For compressed monomials, this is the next one in rank order.
+ */
+inline uint64_t next_combination(const uint64_t &c) {
+	const uint64_t low = c & (~c + 1);
+	const uint64_t ripple = c + low;
+	return ripple | (((c ^ ripple) >> 2) / low);
+}
+
+
+/*
+ * Homogeneous polynomial of degree "degree" in the variables of "vars".
+ * - present is a bitmap indexed by the rank of the monomials.
+ * - block_count[b] is the number of monomials present in the 512 ranks before
+ *   block b, so that the position of a monomial in coeffs is obtained with a
+ *   few popcounts.
+ * - coeffs holds the coefficients of the present monomials, in rank order.
+ */
+template<typename coeff_t>
+class dense_layer {
+public:
+	dense_layer() = default;
+
+	/*
+	 * Builds the layer from the terms of degree "degree" of m. The coefficients
+	 * are moved out of m.
+	 */
+	dense_layer(std::map<uint64_t, coeff_t> &m, const uint64_t &vars, const unsigned int &degree) :
+		vars(vars), degree(degree),
+		present((binomial[__builtin_popcountll(vars)][degree] + 63) / 64, 0),
+		block_count((present.size() + 7) / 8 + 1, 0) {
+		for(const auto &[monom, coeff]: m) {
+			if(((unsigned int) __builtin_popcountll(monom)) == degree) {
+				const uint64_t r = rank(monom);
+				present[r / 64] |= ((uint64_t) 1) << (r % 64);
+			}
+		}
+		for(size_t b = 0; b + 1 < block_count.size(); b++) {
+			block_count[b + 1] = block_count[b];
+			for(size_t w = 8 * b; w < std::min(8 * (b + 1), present.size()); w++)
+				block_count[b + 1] += __builtin_popcountll(present[w]);
+		}
+		coeffs.resize(block_count.back());
+		for(auto &[monom, coeff]: m) {
+			if(((unsigned int) __builtin_popcountll(monom)) == degree)
+				coeffs[index(rank(monom))] = std::move(coeff);
+		}
+	}
+
+	/*
+	 * Returns a pointer to the coefficient of monomial m, or nullptr if m does
+	 * not appear.
+	 */
+	const coeff_t *find(const uint64_t &m) const {
+		if(present.empty() || (m & ~vars) || ((unsigned int) __builtin_popcountll(m)) != degree)
+			return nullptr;
+		const uint64_t r = rank(m);
+		if(!((present[r / 64] >> (r % 64)) & 1))
+			return nullptr;
+		return &coeffs[index(r)];
+	}
+
+	/*
+	 * Calls f(monomial, coefficient) on every term, in rank order.
+	 * Consecutive ranks are walked with Gosper's hack, larger gaps are unranked.
+	 */
+	template<typename F>
+	void for_each(F f) const {
+		uint64_t combination = 0;
+		uint64_t last_rank = 0;
+		bool first = true;
+		size_t i = 0;
+		for(size_t w = 0; w < present.size(); w++) {
+			uint64_t word = present[w];
+			while(word) {
+				const uint64_t r = (64 * w) + __builtin_ctzll(word);
+				word &= (word - 1);
+				if(first || r - last_rank > 8)
+					combination = unrank(r);
+				else {
+					for(uint64_t step = last_rank; step < r; step++)
+						combination = next_combination(combination);
+				}
+				first = false;
+				last_rank = r;
+				f(deposit_monom(combination, vars), coeffs[i++]);
+			}
+		}
+	}
+
+	size_t size() const {
+		return coeffs.size();
+	}
+
+	// Memory used by the bitmap and the rank index, coefficients excluded
+	size_t index_bytes() const {
+		return (present.size() + block_count.size()) * sizeof(uint64_t);
+	}
+
+	// index_bytes of a layer of degree "degree" in the variables of vars
+	static size_t index_bytes_for(const uint64_t &vars, const unsigned int &degree) {
+		const size_t nb_words = (binomial[__builtin_popcountll(vars)][degree] + 63) / 64;
+		return (nb_words + (nb_words + 7) / 8 + 1) * sizeof(uint64_t);
+	}
+
+private:
+	uint64_t vars = 0;
+	unsigned int degree = 0;
+	std::vector<uint64_t> present;
+	std::vector<uint64_t> block_count;
+	std::vector<coeff_t> coeffs;
+
+	// Rank of m among the monomials of the same degree: sum of C(p_t, t + 1)
+	// where p_0 < p_1 < ... are the positions of the variables of m in vars.
+	uint64_t rank(const uint64_t &m) const {
+		uint64_t c = compress_monom(m, vars);
+		uint64_t r = 0;
+		for(unsigned int t = 1; c; t++) {
+			r += binomial[__builtin_ctzll(c)][t];
+			c &= (c - 1);
+		}
+		return r;
+	}
+
+	// Compressed monomial of rank r
+	uint64_t unrank(uint64_t r) const {
+		uint64_t c = 0;
+		unsigned int p = __builtin_popcountll(vars);
+		for(unsigned int t = degree; t > 0; t--) {
+			do {
+				p--;
+			} while(binomial[p][t] > r);
+			c |= ((uint64_t) 1) << p;
+			r -= binomial[p][t];
+		}
+		return c;
+	}
+
+	// Position in coeffs of the monomial of rank r, which is expected to appear
+	size_t index(const uint64_t &r) const {
+		const size_t w = r / 64;
+		size_t i = block_count[w / 8];
+		for(size_t v = 8 * (w / 8); v < w; v++)
+			i += __builtin_popcountll(present[v]);
+		return i + __builtin_popcountll(present[w] & ((((uint64_t) 1) << (r % 64)) - 1));
+	}
+};
+
+
+// Term of a polynomial stored as an array sorted by monomial
+template<typename coeff_t>
+struct poly_term {
+	uint64_t monom;
+	coeff_t coeff;
+};
+
+
+/*
+ * Polynomial in the variables of vars stored either as an array of terms
+ * sorted by monomial, or as one dense layer per degree when it is dense enough
+ * for the bitmaps to be smaller than the sparse terms they replace.
+ * A Bloom filter on its monomials (see bloom_filter.hpp) rules out most of the
+ * lookups of absent monomials before they reach the terms.
+ */
+template<typename coeff_t>
+class layered_poly {
+public:
+	layered_poly() = default;
+
+	layered_poly(std::map<uint64_t, coeff_t> &&m, const uint64_t &vars) {
+		const std::array<size_t, 65> count = degree_count(m);
+		filter = bloom_filter(m.size());
+		for(const auto &[monom, coeff]: m)
+			filter.insert(monom);
+
+		dense = is_dense_enough(m, vars, count);
+		if(dense) {
+			layers.resize(65);
+			for(unsigned int d = 0; d <= (unsigned int) __builtin_popcountll(vars); d++) {
+				if(count[d])
+					layers[d] = dense_layer<coeff_t>(m, vars, d);
+			}
+			nb_terms = m.size();
+		}
+		else {
+			sparse.reserve(m.size());
+			for(auto &[monom, coeff]: m)
+				sparse.push_back({monom, std::move(coeff)});
+			nb_terms = sparse.size();
+		}
+	}
+
+	const coeff_t *find(const uint64_t &m) const {
+		if(dense)
+			return layers[__builtin_popcountll(m)].find(m);
+		const auto it = std::lower_bound(sparse.begin(), sparse.end(), m, [](const poly_term<coeff_t> &t, const uint64_t &x) {return t.monom < x;});
+		return (it != sparse.end() && it->monom == m) ? &(it->coeff) : nullptr;
+	}
+
+	// False only if m does not appear
+	bool might_contain(const uint64_t &m) const {
+		return filter.might_contain(m);
+	}
+
+	// Sparse terms are visited in increasing order of monomials, dense ones by degree first
+	template<typename F>
+	void for_each(F f) const {
+		if(dense) {
+			for(const auto &l: layers)
+				l.for_each(f);
+		}
+		else {
+			for(const auto &t: sparse)
+				f(t.monom, t.coeff);
+		}
+	}
+
+	// Terms sorted by monomial, or an empty span if the polynomial is dense
+	std::span<const poly_term<coeff_t>> sorted_terms() const {
+		return sparse;
+	}
+
+	size_t size() const {
+		return nb_terms;
+	}
+
+	bool empty() const {
+		return size() == 0;
+	}
+
+	bool is_dense() const {
+		return dense;
+	}
+
+	// Approximate memory used by the terms, heap data owned by the coefficients excluded
+	size_t bytes() const {
+		if(!dense)
+			return sparse.size() * sizeof(poly_term<coeff_t>) + filter.bytes();
+		size_t b = nb_terms * sizeof(coeff_t) + filter.bytes();
+		for(const auto &l: layers)
+			b += l.index_bytes();
+		return b;
+	}
+
+	// bytes() of the polynomial built from m, without building it
+	static size_t bytes_for(const std::map<uint64_t, coeff_t> &m, const uint64_t &vars) {
+		const std::array<size_t, 65> count = degree_count(m);
+		if(!is_dense_enough(m, vars, count))
+			return m.size() * sizeof(poly_term<coeff_t>) + bloom_filter::bytes_for(m.size());
+		size_t b = m.size() * sizeof(coeff_t) + bloom_filter::bytes_for(m.size());
+		for(unsigned int d = 0; d <= (unsigned int) __builtin_popcountll(vars); d++) {
+			if(count[d])
+				b += dense_layer<coeff_t>::index_bytes_for(vars, d);
+		}
+		return b;
+	}
+
+private:
+	// Size of a sparse term, coefficient excluded
+	static constexpr size_t node_bytes = sizeof(poly_term<coeff_t>) - sizeof(coeff_t);
+
+	// Number of terms of each degree
+	static std::array<size_t, 65> degree_count(const std::map<uint64_t, coeff_t> &m) {
+		std::array<size_t, 65> count = {};
+		for(const auto &[monom, coeff]: m)
+			count[__builtin_popcountll(monom)]++;
+		return count;
+	}
+
+	// True if the bitmaps of the degrees in count are smaller than the sparse terms
+	static bool is_dense_enough(const std::map<uint64_t, coeff_t> &m, const uint64_t &vars, const std::array<size_t, 65> &count) {
+		const unsigned int nb_vars = __builtin_popcountll(vars);
+		size_t dense_bytes = 0;
+		for(unsigned int d = 0; d <= nb_vars; d++) {
+			if(count[d])
+				dense_bytes += (binomial[nb_vars][d] / 8) * 9 / 8;
+		}
+		bool dense = !m.empty() && dense_bytes < m.size() * node_bytes;
+		for(const auto &[monom, coeff]: m)
+			dense = dense && !(monom & ~vars); // Only monomials in the variables of vars can be ranked
+		return dense;
+	}
+
+	bool dense = false;
+	size_t nb_terms = 0;
+	std::vector<poly_term<coeff_t>> sparse;
+	std::vector<dense_layer<coeff_t>> layers;
+	bloom_filter filter;
+};
+
+#endif /* DENSE_LAYER_HPP */
@@ -0,0 +1,99 @@
+/*
+ * Practical cube-attack against nonce-misused ASCON
+ * Filename : hash_poly.hpp
+ * Content : Sparse storage of polynomials in v_i in an open-addressing hash
+ *           table keyed on the monomials, used to accumulate the products of
+ *           S5.
+*/
+
+#ifndef HASH_POLY_HPP
+#define HASH_POLY_HPP
+
+#include <map>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <algorithm>
+
+/*
+ * Hash table from monomials to coefficients with linear probing, of which at
+ * most half of the slots are used: an insertion usually reads a single slot.
+ * Empty slots hold the monomial with all 64 variables, which never appears as
+ * the degrees are at most 32. Coefficients are inserted as coeff_t(), i.e. 0
+ * in the rings of rings.hpp.
+ */
+template<typename coeff_t>
+class hash_poly {
+public:
+	static constexpr uint64_t empty_key = ~((uint64_t) 0);
+
+	hash_poly() = default;
+
+	// Coefficient of m, inserted as 0 if m is not in the table yet
+	coeff_t &find_or_insert(const uint64_t &m) {
+		if(2 * (nb_terms + 1) > slots.size())
+			rehash(std::max<size_t>(16, 2 * slots.size()));
+		size_t i = slot(m);
+		while(slots[i].first != m) {
+			if(slots[i].first == empty_key) {
+				slots[i].first = m;
+				nb_terms++;
+				break;
+			}
+			i = (i + 1) & (slots.size() - 1);
+		}
+		return slots[i].second;
+	}
+
+	// Brings the slot of m into the cache ahead of an insertion
+	void prefetch(const uint64_t &m) const {
+		if(!slots.empty())
+			__builtin_prefetch(&slots[slot(m)]);
+	}
+
+	// Moves the terms to a map, built in bulk from the sorted terms. The table is left empty.
+	std::map<uint64_t, coeff_t> to_map() {
+		std::vector<slot_t> sorted;
+		sorted.reserve(nb_terms);
+		for(auto &s: slots) {
+			if(s.first != empty_key)
+				sorted.push_back(std::move(s));
+		}
+		slots = std::vector<slot_t>();
+		nb_terms = 0;
+		std::sort(sorted.begin(), sorted.end(), [](const slot_t &s1, const slot_t &s2) {return s1.first < s2.first;});
+
+		std::map<uint64_t, coeff_t> m;
+		for(auto &[monom, coeff]: sorted)
+			m.emplace_hint(m.end(), monom, std::move(coeff));
+		return m;
+	}
+
+private:
+	using slot_t = std::pair<uint64_t, coeff_t>;
+
+	std::vector<slot_t> slots; // Power of 2 number of slots
+	size_t nb_terms = 0;
+	unsigned int shift = 64;
+
+	// Multiplicative hashing: the monomials of a cube only differ on a few bits,
+	// which the multiplication spreads over the high bits kept as the slot.
+	size_t slot(const uint64_t &m) const {
+		return (m * 0x9e3779b97f4a7c15ULL) >> shift;
+	}
+
+	void rehash(const size_t &capacity) {
+		std::vector<slot_t> old(capacity);
+		for(auto &s: old)
+			s.first = empty_key;
+		old.swap(slots);
+		shift = 64 - __builtin_ctzll(capacity);
+		nb_terms = 0;
+		for(auto &[monom, coeff]: old) {
+			if(monom != empty_key)
+				find_or_insert(monom) = std::move(coeff);
+		}
+	}
+};
+
+#endif /* HASH_POLY_HPP */
@@ -0,0 +1,161 @@
+/*
+ * Practical cube-attack against nonce-misused ASCON
+ * Filename : l4.hpp
+ * Content : State after THE FIRST 4 ROUNDS of ASCON as polynomials in v_i
+ *           whose coefficients are taken in a ring R (see rings.hpp), computed
+ *           all at once or on demand.
+*/
+
+#ifndef L4_HPP
+#define L4_HPP
+
+#include <map>
+#include "sharding.hpp"
+
+// polynomial whose variables are v_i and coefficients are in R
+template<typename R>
+using poly_map_in = std::map<uint64_t, typename R::coeff>;
+
+/*
+ * State after L3 from which the coordinates after L4 are computed on demand.
+ * Each coordinate of l3 is only computed by the first request which needs it,
+ * l3 and s4 are only kept in compressed form.
+ */
+template<typename R>
+struct lazy_l4_in {
+	state start;
+	uint nb_workers = 1;
+	coor_mask l3_done;
+	packed_state l3;
+	packed_state s4;
+	coor_mask s4_done;
+	std::array<poly_map_in<R>, 320> l4;
+	coor_mask l4_done;
+	size_t saved_bytes = 0;
+};
+
+
+/*
+ * Converts a coordinate seen as a set of monomials into a polynomial whose
+ * variables are v_i and coefficients are in R.
+ * This corresponds to a usual F[x,y] = F[x][y] isomorphism.
+ */
+template<typename R>
+const poly_map_in<R> convert_coor_to_poly_map(const coor &c) {
+	poly_map_in<R> m;
+	for(const auto &x: c)
+		R::add_monom(m.try_emplace(x[0], R::zero()).first->second, x);
+	return m;
+}
+
+
+/*
+ * Converts the state into an array of poly_maps.
+ * Each coordinate of l4 is released as soon as it is converted.
+ */
+template<typename R>
+std::array<poly_map_in<R>, 320> convert_l4(state &&l4) {
+	std::cout << "conversion..." << std::endl;
+
+	std::array<poly_map_in<R>, 320> l4_converted;
+#pragma omp parallel for default(none) shared(l4_converted, l4, std::cout)
+	for(uint i = 0; i < 320; i++) {
+		l4_converted[i] = convert_coor_to_poly_map<R>(l4[i]);
+		coor().swap(l4[i]);
+		std::cout << "|" << std::flush;
+	}
+	std::cout << std::endl;
+
+	std::cout << "l4_converted avg: ";
+	for(uint i = 0; i < 5; i++) {
+		uint mean = 0;
+		for(uint j = 0; j < 64; j++) {
+			mean += l4_converted[i * 64 + j].size();
+		}
+		std::cout << std::to_string(static_cast<int>(((float) mean) / 64)) + " | ";
+	}
+	std::cout << std::endl;
+
+	return l4_converted;
+}
+
+
+/*
+ * Returns the state after the fourth linear layer as an array of poly_map
+ * from a given initial state.
+ * Only the coordinates in l4_needed are computed, the other ones are left empty.
+ * With nb_workers > 1, the computation is split between as many processes (see
+ * sharding.hpp).
+ */
+template<typename R, typename S>
+std::array<poly_map_in<R>, 320> compute_l4(const state &start, const coor_mask &l4_needed, const uint &nb_workers) {
+	if(nb_workers > 1)
+		return convert_l4<R>(gather_layers<S>(start, backward_cone<S>(l4_needed), 2 * S::nb_rounds - 1, nb_workers));
+	return convert_l4<R>(build_state_l4<S>(start, l4_needed));
+}
+
+
+/*
+ * Starts a demand-driven computation of l4: the coordinates after L4, and the
+ * ones of the state after the third linear layer they read, are only computed
+ * when require_l4 asks for them. With nb_workers > 1, l3 is computed by as
+ * many processes (see sharding.hpp). Coordinates already known (e.g. read from a cache) can be
+ * stored in l4 and marked in l4_done beforehand.
+ * The states kept for later requests (l3 and the computed part of s4) are
+ * compressed, and only decompressed where a request needs them.
+ */
+template<typename R>
+lazy_l4_in<R> init_lazy_l4(const state &start, const uint &nb_workers) {
+	lazy_l4_in<R> lazy;
+	lazy.start = start;
+	lazy.nb_workers = nb_workers;
+	return lazy;
+}
+
+
+/*
+ * Completes lazy.l4 with the coordinates in l4_needed. The coordinates of l4,
+ * s4 and l3 which were already computed by a previous call are reused.
+ * The missing coordinates of l3 are computed from lazy.start over their own
+ * backward cone: the first rounds are computed again by each call which
+ * extends l3, only on the coordinates its cone needs.
+ */
+template<typename R, typename S>
+void require_l4(lazy_l4_in<R> &lazy, const coor_mask &l4_needed) {
+	const coor_mask l4_missing = l4_needed & ~lazy.l4_done;
+	if(l4_missing.none())
+		return;
+
+	const coor_mask s4_needed = lin_layer_cone(l4_missing);
+	const coor_mask s4_missing = s4_needed & ~lazy.s4_done;
+	const coor_mask l3_needed = sbox_cone(s4_missing, S::quadratic_rounds[S::nb_rounds - 1]);
+	const coor_mask l3_missing = l3_needed & ~lazy.l3_done;
+	if(l3_missing.any()) {
+		const uint l3_layer = 2 * S::nb_rounds - 3;
+		const layer_masks<S> cone = backward_cone<S>(l3_missing, l3_layer);
+		state l3 = (lazy.nb_workers > 1) ? gather_layers<S>(lazy.start, cone, l3_layer, lazy.nb_workers) : build_state_l3<S>(lazy.start, cone);
+		lazy.saved_bytes += pack_state(l3, l3_missing, lazy.l3);
+		lazy.l3_done |= l3_missing;
+		std::cout << "l3 compressed, " << l3_missing.count() << " new coordinates (" << lazy.l3_done.count() << "/320)" << std::endl;
+	}
+
+	{
+		state s4 = build_state_s4<S>(unpack_state(lazy.l3, l3_needed), s4_missing);
+		lazy.saved_bytes += pack_state(s4, s4_missing, lazy.s4);
+	}
+	lazy.s4_done |= s4_missing;
+
+	const state l4 = lin_layer(unpack_state(lazy.s4, s4_needed), l4_missing);
+#pragma omp parallel for default(none) shared(lazy, l4, l4_missing)
+	for(uint i = 0; i < 320; i++) {
+		if(l4_missing[i])
+			lazy.l4[i] = convert_coor_to_poly_map<R>(l4[i]);
+	}
+	lazy.l4_done |= l4_missing;
+	std::cout << "L4 on demand: " << s4_missing.count() << " new s4 coordinates, "
+	          << l4_missing.count() << " new l4 coordinates (" << lazy.l4_done.count() << "/320), "
+	          << (lazy.saved_bytes >> 20) << "MB saved by compression" << std::endl;
+	print_idle("L4 on demand");
+}
+
+#endif /* L4_HPP */
@@ -0,0 +1,100 @@
+/*
+ * Practical cube-attack against nonce-misused ASCON
+ * Filename : popcount_filter.hpp
+ * Content : Selection of the monomials sharing few variables with a given
+ *           monomial, vectorized with AVX-512 or AVX2 when the processor
+ *           supports them (checked at runtime), used to find the pairs of
+ *           terms multiplied in S5.
+*/
+
+#ifndef POPCOUNT_FILTER_HPP
+#define POPCOUNT_FILTER_HPP
+
+#include <cstdint>
+#include <cstddef>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/*
+ * Writes to out the indices i < n such that m & keys[i] has at most k bits
+ * set, in increasing order, and returns their number. out must have room for
+ * n indices.
+ */
+inline size_t select_sharing_at_most_scalar(const uint64_t &m, const uint64_t *keys, const size_t &n, const unsigned int &k, uint32_t *out) {
+	size_t nb = 0;
+	for(size_t i = 0; i < n; i++) {
+		out[nb] = i;
+		nb += ((unsigned int) __builtin_popcountll(m & keys[i]) <= k);
+	}
+	return nb;
+}
+
+
+#if defined(__x86_64__)
+// 8 keys at a time with VPOPCNTQ, the indices being compacted by VPCOMPRESSD
+__attribute__((target("avx512f,avx512vpopcntdq")))
+inline size_t select_sharing_at_most_avx512(const uint64_t &m, const uint64_t *keys, const size_t &n, const unsigned int &k, uint32_t *out) {
+	const __m512i vm = _mm512_set1_epi64(m);
+	const __m512i vk = _mm512_set1_epi64(k);
+	__m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	size_t nb = 0;
+	for(size_t i = 0; i < n; i += 8) {
+		const __mmask8 valid = (n - i >= 8) ? 0xff : (__mmask8) ((1u << (n - i)) - 1);
+		const __m512i shared = _mm512_and_si512(_mm512_maskz_loadu_epi64(valid, keys + i), vm);
+		const __mmask8 selected = _mm512_mask_cmple_epu64_mask(valid, _mm512_popcnt_epi64(shared), vk);
+		_mm512_mask_compressstoreu_epi32(out + nb, selected, _mm512_castsi256_si512(index));
+		nb += __builtin_popcount(selected);
+		index = _mm256_add_epi32(index, _mm256_set1_epi32(8));
+	}
+	return nb;
+}
+
+
+// 4 keys at a time, the popcounts being summed from a lookup table on nibbles
+__attribute__((target("avx2")))
+inline size_t select_sharing_at_most_avx2(const uint64_t &m, const uint64_t *keys, const size_t &n, const unsigned int &k, uint32_t *out) {
+	const __m256i vm = _mm256_set1_epi64x(m);
+	const __m256i vk = _mm256_set1_epi64x(k);
+	const __m256i nibble_mask = _mm256_set1_epi8(0x0f);
+	const __m256i nibble_popcount = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+	                                                 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	size_t nb = 0;
+	size_t i = 0;
+	for(; i + 4 <= n; i += 4) {
+		const __m256i shared = _mm256_and_si256(_mm256_loadu_si256((const __m256i *) (keys + i)), vm);
+		const __m256i low = _mm256_shuffle_epi8(nibble_popcount, _mm256_and_si256(shared, nibble_mask));
+		const __m256i high = _mm256_shuffle_epi8(nibble_popcount, _mm256_and_si256(_mm256_srli_epi64(shared, 4), nibble_mask));
+		const __m256i popcount = _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256());
+		const uint32_t rejected = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(popcount, vk)));
+		for(uint32_t selected = ~rejected & 0xf; selected; selected &= selected - 1)
+			out[nb++] = i + __builtin_ctz(selected);
+	}
+	for(; i < n; i++) {
+		out[nb] = i;
+		nb += ((unsigned int) __builtin_popcountll(m & keys[i]) <= k);
+	}
+	return nb;
+}
+#endif
+
+
+using select_sharing_at_most_t = size_t (*)(const uint64_t &, const uint64_t *, const size_t &, const unsigned int &, uint32_t *);
+
+/*
+ * Returns the fastest version of select_sharing_at_most supported by the processor.
+ */
+inline select_sharing_at_most_t select_sharing_at_most_kernel() {
+#if defined(__x86_64__)
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq"))
+		return select_sharing_at_most_avx512;
+	if(__builtin_cpu_supports("avx2"))
+		return select_sharing_at_most_avx2;
+#endif
+	return select_sharing_at_most_scalar;
+}
+
+inline const select_sharing_at_most_t select_sharing_at_most = select_sharing_at_most_kernel();
+
+#endif /* POPCOUNT_FILTER_HPP */
@@ -0,0 +1,240 @@
+/*
+ * Practical cube-attack against nonce-misused ASCON
+ * Filename : rings.hpp
+ * Content : Rings of the coefficients of the polynomials in v_i, i.e. of the
+ *           polynomials in the non-cube variables which are kept by each phase.
+ *
+ * A ring R provides:
+ *  - R::coeff, the type of the coefficients,
+ *  - R::zero() and R::is_zero(c),
+ *  - R::add(c, d), which adds d to c, and R::mul(c, d), which returns c*d,
+ *  - R::add_monom(c, m), which adds to c the part of the monomial m of the
+ *    ASCON state which is not in v_i,
+ *  - R::length(c), the number of monomials of c,
+ *  - R::to_txt(c), the text written to the results.
+*/
+
+#ifndef RINGS_HPP
+#define RINGS_HPP
+
+#include "anf.hpp"
+
+/*
+ * Polynomials in a_i (phase 2), as sets of monomials of the ASCON state. The
+ * monomials keep their part in v_i, which is the same for all the monomials of
+ * a coefficient, so that the additions and multiplications are those of coor.
+ */
+struct ring_a {
+	using coeff = coor;
+
+	static coeff zero() {
+		return coeff();
+	}
+
+	static bool is_zero(const coeff &c) {
+		return c.empty();
+	}
+
+	static void add(coeff &c, const coeff &d) {
+		c = add_coor(c, d);
+	}
+
+	static coeff mul(const coeff &c, const coeff &d) {
+		return mult_coor(c, d, no_filter());
+	}
+
+	static void add_monom(coeff &c, const monom &m) {
+		if(c.contains(m))
+			c.erase(m);
+		else
+			c.insert(m);
+	}
+
+	static size_t length(const coeff &c) {
+		return c.size();
+	}
+
+	static std::string to_txt(const coeff &c) {
+		std::string s;
+		bool plus = false;
+
+		for(const auto &m: c) {
+			if(!plus)
+				plus = true;
+			else
+				s += " + ";
+
+			bool times = false;
+			for(uint j = 0; j < 64; j++) {
+				if((m[1] >> (63 - j)) & 1) {
+					if(!times)
+						times = true;
+					else
+						s += "*";
+
+					s.append("a").append(std::to_string(j));
+				}
+			}
+
+			if(!times) // Handles the case of the cst coefficient
+				s.assign(1, '1');
+		}
+		if(s.empty())
+			s = "0";
+		return s;
+	}
+};
+
+
+/*
+ * Polynomials whose monomials can only be 1, b_i*c_i, b_i and c_i (phase 3).
+ * Word 0 is the constant, and words 1, 2 and 3 hold the b_i*c_i, b_i and c_i.
+ * Such polynomials are not closed under multiplication: mul expects one of
+ * its operands to be constant, which the degree schedule of phase 3
+ * guarantees as long as it only keeps the highest-degree and sub-leading
+ * terms (the terms of highest degree have constant coefficients).
+ */
+struct ring_bc {
+	using coeff = std::array<uint64_t, 4>;
+
+	static coeff zero() {
+		return {(uint64_t) 0, (uint64_t) 0, (uint64_t) 0, (uint64_t) 0};
+	}
+
+	static bool is_zero(const coeff &c) {
+		return !(c[0] || c[1] || c[2] || c[3]);
+	}
+
+	static bool is_constant(const coeff &c) {
+		return !(c[1] || c[2] || c[3]);
+	}
+
+	static void add(coeff &c, const coeff &d) {
+		for(uint i = 0; i < 4; i++)
+			c[i] ^= d[i];
+	}
+
+	static coeff mul(const coeff &c, const coeff &d) {
+		if(is_constant(c))
+			return c[0] ? d : zero();
+		return d[0] ? c : zero();
+	}
+
+	static size_t length(const coeff &c) {
+		size_t l = 0;
+		for(const auto &w: c)
+			l += __builtin_popcountll(w);
+		return l;
+	}
+
+	static void add_monom(coeff &c, const monom &m) {
+		if(m[2] && m[3])
+			c[1] ^= m[2]; // b_i*c_i
+		else if(m[2])
+			c[2] ^= m[2]; // b_i
+		else if(m[3])
+			c[3] ^= m[3]; // c_i
+		else
+			c[0] ^= ((uint64_t) 1); // 1
+	}
+
+	static std::string to_txt(const coeff &m) {
+		std::string s;
+		bool first = true;
+		if(m[0]) { // Handles the constant, row 0 of the coefficient
+			s = "1";
+			first = false;
+		}
+
+		for(uint i = 1; i < 4; i++) { // Handles rows 1, 2 and 3
+			if(m[i]) {
+				for(uint j = 0; j < 64; j++) {
+					if((m[i] >> (63 - j)) & 1) {
+						if(first)
+							first = false;
+						else
+							s += " + ";
+
+						if(i == 1)
+							s += "b" + std::to_string(j) + "*c" + std::to_string(j);
+						else if(i == 2)
+							s += "b" + std::to_string(j);
+						else
+							s += "c" + std::to_string(j);
+					}
+				}
+			}
+		}
+
+		if(first) // Handles the case of the null coefficient
+			s = "0\n";
+		else
+			s += "\n";
+
+		return s;
+	}
+};
+
+
+
+/*
+ * General polynomials in a_i, b_i, c_i and e_i, as sets of monomials of the
+ * ASCON state whose part in v_i is cleared. Needed by the terms below the
+ * sub-leading ones, whose coefficients have no particular shape; the
+ * multiplications are those of coor, hence much slower than in ring_bc.
+ */
+struct ring_anf {
+	using coeff = coor;
+
+	static coeff zero() {
+		return coeff();
+	}
+
+	static bool is_zero(const coeff &c) {
+		return c.empty();
+	}
+
+	static void add(coeff &c, const coeff &d) {
+		c = add_coor(c, d);
+	}
+
+	static coeff mul(const coeff &c, const coeff &d) {
+		return mult_coor(c, d, no_filter());
+	}
+
+	static void add_monom(coeff &c, monom m) {
+		m[0] = 0;
+		if(c.contains(m))
+			c.erase(m);
+		else
+			c.insert(m);
+	}
+
+	static size_t length(const coeff &c) {
+		return c.size();
+	}
+
+	static std::string to_txt(const coeff &c) {
+		const std::array<std::string, 4> names = {"a", "b", "c", "e"};
+		std::string s;
+
+		for(const auto &m: c) {
+			if(!s.empty())
+				s += " + ";
+
+			std::string t;
+			for(uint k = 1; k < 5; k++) {
+				for(uint j = 0; j < 64; j++) {
+					if((m[k] >> (63 - j)) & 1)
+						t += (t.empty() ? "" : "*") + names[k - 1] + std::to_string(j);
+				}
+			}
+			s += t.empty() ? "1" : t; // Handles the case of the cst monomial
+		}
+		if(s.empty())
+			s = "0";
+		return s;
+	}
+};
+
+#endif /* RINGS_HPP */
@@ -0,0 +1,439 @@
+/*
+ * Practical cube-attack against nonce-misused ASCON
+ * Filename : rounds_1_to_4.hpp
+ * Content : S-box and linear layers of THE FIRST ROUNDS of ASCON (4 in the
+ *           6-round attack) on the symbolic state, and their backward
+ *           dependency cones.
+ *           The computation is not exhaustive, it only computes the part of the
+ *           ANF which is needed.
+ *
+ * The layers are specialized at compile time for a degree schedule S, a type
+ * with the static members:
+ *  - S::nb_rounds: the number of rounds computed on the symbolic state, the
+ *    last 1.5 rounds being handled by rounds_5_6.hpp. Whatever this number,
+ *    the state after them is called l4, the S-box layer before it s4, etc.
+ *  - S::quadratic_rounds[r]: whether only the quadratic part of the S-box of
+ *    round r + 1 is needed,
+ *  - S::sbox_degrees[r]: the degrees in v_i of the products kept by the S-box
+ *    layer of round r + 1 (all_degrees to keep all of them),
+ *  - S::s5_min and S::s5_max: the degrees in v_i of the terms kept after the
+ *    next S-box layer, called S5 (see rounds_5_6.hpp).
+ * cube_schedule below derives such a schedule from the degree of the targets;
+ * each phase picks its own in its rounds_1_to_4.hpp.
+*/
+
+#ifndef ANF_ROUNDS_1_TO_4_HPP
+#define ANF_ROUNDS_1_TO_4_HPP
+
+#include <algorithm>
+#include "anf.hpp"
+
+// Coordinates to compute in each layer of the first rounds: s1, l1, s2, ...
+template<typename S>
+using layer_masks = std::array<coor_mask, 2 * S::nb_rounds>;
+
+/*
+ * Schedule of the monomials of degree 2^(rounds + 1) - drop after S6, the
+ * S-box layer following S5, when "rounds" rounds are computed on the symbolic
+ * state (drop is 0 for phase 2, 1 for phase 3 in the 6-round attack).
+ * After the S-box layer of round r + 1 (r >= 1) the degree in v_i is at most
+ * 2^r, and a term of degree d comes from products of terms of degree at least
+ * d - 2^(r-1): keeping the degrees 2^r - drop to 2^r after each S-box layer is
+ * enough. The linear terms passed on by an S-box layer have degree at most
+ * 2^(r-1), so only its quadratic part is needed when they are below this
+ * window. Each degree dropped halves the online cube but widens the windows,
+ * and the coefficients of the lower-degree terms are no longer of the simple
+ * form of the highest-degree ones (see rings.hpp).
+ */
+template<uint rounds, uint drop>
+struct cube_schedule {
+	static_assert(rounds >= 2 && rounds <= 5, "the targets must fit in the 64 cube variables");
+	// Otherwise the linear part of S5 would reach the terms kept after it
+	static_assert(drop < (1u << (rounds - 1)), "S5 must be quadratic on the kept terms");
+
+	static constexpr uint nb_rounds = rounds;
+	static constexpr uint target_degree = (2u << rounds) - drop;
+
+	static constexpr std::array<bool, rounds> quadratic_rounds = [] {
+		std::array<bool, rounds> q;
+		q[0] = false;
+		for(uint r = 1; r < rounds; r++)
+			q[r] = drop < (1u << (r - 1));
+		return q;
+	}();
+
+	static constexpr std::array<degree_set, rounds> sbox_degrees = [] {
+		std::array<degree_set, rounds> d;
+		d[0] = all_degrees;
+		for(uint r = 1; r < rounds; r++) {
+			d[r] = 0;
+			for(uint k = (drop < (1u << r)) ? (1u << r) - drop : 0; k <= (1u << r); k++)
+				d[r] |= degrees({k});
+		}
+		return d;
+	}();
+
+	static constexpr uint s5_min = (1u << rounds) - drop;
+	static constexpr uint s5_max = 1u << rounds;
+};
+
+// Rotation amounts of the linear layer, two per row
+inline constexpr std::array<uint, 10> shifts = {45, 36, 3, 25, 63, 58, 54, 47, 57, 23};
+
+/*
+ * Input rows needed by each output row of the S-box, as 5-bit masks (bit i
+ * stands for x_i), for the quadratic part only and for the true S-box.
+ */
+inline constexpr std::array<uint, 5> sbox_inputs_quadratic = {0b10111, 0b01110, 0b11000, 0b11001, 0b10011};
+inline constexpr std::array<uint, 5> sbox_inputs_true = {0b11111, 0b11111, 0b11110, 0b11111, 0b11011};
+
+/*
+ * Quadratic terms of each output row of the S-box, as 5-bit masks of their two
+ * input rows (0 for none): y0 = x1x2 + x1x4 + x0x1 + ..., y1 = x2x3 + x1x3 + x1x2 + ...,
+ * y2 = x3x4 + ..., y3 = x0x3 + x0x4 + ... and y4 = x1x4 + x0x1 + ...
+ */
+inline constexpr std::array<std::array<uint, 3>, 5> sbox_quadratic_terms = {{{0b00110, 0b10010, 0b00011}, {0b01100, 0b01010, 0b00110},
+                                                                               {0b11000, 0, 0}, {0b01001, 0b10001, 0}, {0b10010, 0b00011, 0}}};
+
+
+/*
+ * ASCON Sbox function.
+ * Input coordinates : x0 to x4
+ * Output coordinates: y0 to y4
+ * The Boolean parameter "quadrqtic" is used to indicate whether we need to
+ * compute the whole Sbox layer or only the quadratic terms of the Sbox.
+ * condition_mult is used to filter the resulting multiplications of coordinates.
+ * rows is a 5-bit mask of the output coordinates to compute (bit i stands for
+ * y_i), the other ones are left empty and their products are skipped.
+ */
+template<typename filter_t>
+void sbox(const coor &x0, const coor &x1, const coor &x2, const coor &x3,
+          const coor &x4, coor &y0, coor &y1, coor &y2, coor &y3, coor &y4,
+          const bool &quadratic, const filter_t &condition_mult, const uint &rows) {
+	const auto needs = [&rows](const uint &i) { return (rows >> i) & 1; };
+
+	// Only the products appearing in a requested output are computed
+	const coor x2x1 = (needs(0) || needs(1)) ? mult_coor(x2, x1, condition_mult) : coor();
+	coor x4x3 = needs(2) ? mult_coor(x4, x3, condition_mult) : coor();
+	coor x0_x3x4 = needs(3) ? mult_coor(x0, add_coor(x3, x4), condition_mult) : coor();
+	coor x1_x4x0 = (needs(0) || needs(4)) ? mult_coor(x1, add_coor(x4, x0), condition_mult) : coor();
+	const coor x2x1_x3 = needs(1) ? mult_coor(add_coor(x2, x1), x3, condition_mult) : coor();
+
+	// Each output coordinate is obtained through a single fused addition
+	if(quadratic) {
+		if(needs(0))
+			add_coors({&x2x1, &x1_x4x0}, y0);
+		if(needs(1))
+			add_coors({&x2x1_x3, &x2x1}, y1);
+		if(needs(2))
+			y2 = std::move(x4x3);
+		if(needs(3))
+			y3 = std::move(x0_x3x4);
+		if(needs(4))
+			y4 = std::move(x1_x4x0);
+	}
+	else {
+		const coor const_one = {{0,0,0,0,0}};
+		if(needs(0))
+			add_coors({&x2x1, &x1_x4x0, &x0, &x1, &x2, &x3}, y0);
+		if(needs(1))
+			add_coors({&x2x1_x3, &x2x1, &x0, &x1, &x2, &x3, &x4}, y1);
+		if(needs(2))
+			add_coors({&x4x3, &x1, &x2, &const_one, &x4}, y2);
+		if(needs(3))
+			add_coors({&x0_x3x4, &x0, &x1, &x2, &x3, &x4}, y3);
+		if(needs(4))
+			add_coors({&x1_x4x0, &x1, &x3, &x4}, y4);
+	}
+}
+
+
+/*
+ * Estimated cost of the S-box on column col: the number of monomial products
+ * computed by mult_coor, i.e. the products of the lengths of its operands.
+ * Only the products needed by the output rows in the 5-bit mask rows are counted.
+ */
+inline size_t sbox_cost(const state &s, const uint &col, const uint &rows) {
+	const size_t x0 = s[col].size();
+	const size_t x1 = s[col + 64].size();
+	const size_t x2 = s[col + 128].size();
+	const size_t x3 = s[col + 192].size();
+	const size_t x4 = s[col + 256].size();
+	const auto needs = [&rows](const uint &i) { return (rows >> i) & 1; };
+	return ((needs(0) || needs(1)) ? x2 * x1 : 0) + (needs(2) ? x4 * x3 : 0) + (needs(3) ? x0 * (x3 + x4) : 0)
+	       + ((needs(0) || needs(4)) ? x1 * (x4 + x0) : 0) + (needs(1) ? (x2 + x1) * x3 : 0);
+}
+
+
+/*
+ * Returns the indices of the tasks sorted by decreasing estimated cost, so that
+ * the largest tasks are dispatched first and the small ones fill the gaps.
+ */
+inline std::vector<uint> largest_first(const std::vector<size_t> &costs) {
+	std::vector<uint> order(costs.size());
+	for(uint i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&costs](const uint &i, const uint &j) { return costs[i] > costs[j]; });
+	return order;
+}
+
+
+/*
+ * Time each thread spent working and wall-clock time of the parallel steps of
+ * the layers, summed until print_idle is called: the idle times are printed
+ * once per state build rather than once per layer.
+ */
+struct idle_times {
+	std::vector<double> busy;
+	double wall = 0;
+
+	void add(const std::vector<double> &step_busy, const double &step_wall) {
+		busy.resize(std::max(busy.size(), step_busy.size()), 0);
+		for(uint t = 0; t < step_busy.size(); t++)
+			busy[t] += step_busy[t];
+		wall += step_wall;
+	}
+};
+
+inline idle_times layer_idle;
+
+
+/*
+ * Prints the time each thread spent idle during the layers computed since the
+ * previous call, and starts a new count.
+ */
+inline void print_idle(const std::string &name) {
+	if(layer_idle.wall > 0) {
+		double total_busy = 0;
+		std::cout << name << " idle per thread (ms):";
+		for(const auto &b: layer_idle.busy) {
+			std::cout << " " << std::to_string(static_cast<int>((layer_idle.wall - b) * 1000));
+			total_busy += b;
+		}
+		std::cout << " | efficiency: " << std::to_string(static_cast<int>(100 * total_busy / (layer_idle.wall * layer_idle.busy.size()))) << "%" << std::endl;
+	}
+	layer_idle = idle_times();
+}
+
+
+/*
+ * Returns the new state after applying the Sbox to the 64 columns of the state.
+ * Only the coordinates in needed are computed, the other ones are left empty.
+ */
+template<typename filter_t>
+state sbox_state(const state &s, const bool &quadratic, const filter_t &condition_mult, const coor_mask &needed) {
+	state new_state;
+
+	// Output rows to compute in each column
+	std::array<uint, 64> rows;
+	for(uint i = 0; i < 64; i++) {
+		rows[i] = 0;
+		for(uint j = 0; j < 5; j++)
+			rows[i] |= (needed[(j * 64) + i] << j);
+	}
+
+	// Columns are dispatched dynamically, the most expensive ones first
+	std::vector<size_t> costs(64);
+	for(uint i = 0; i < 64; i++)
+		costs[i] = sbox_cost(s, i, rows[i]);
+	const std::vector<uint> order = largest_first(costs);
+
+	std::vector<double> busy(omp_get_max_threads(), 0);
+	const double start = omp_get_wtime();
+
+#pragma omp parallel for schedule(dynamic, 1) default(none) shared(s, new_state, rows, order, busy, quadratic, condition_mult)
+	for(uint k = 0; k < 64; k++) {
+		const double start_col = omp_get_wtime();
+		const uint i = order[k];
+		if(rows[i]) {
+			sbox(s[i], s[i + 64], s[i + 128], s[i + 192], s[i + 256],
+			     new_state[i], new_state[i + 64], new_state[i + 128],
+			     new_state[i + 192], new_state[i + 256], quadratic, condition_mult, rows[i]);
+		}
+		busy[omp_get_thread_num()] += omp_get_wtime() - start_col;
+	}
+	layer_idle.add(busy, omp_get_wtime() - start);
+	return new_state;
+}
+
+
+/*
+ * ASCON linear layer
+ * Only the coordinates in needed are computed, the other ones are left empty.
+ */
+inline state lin_layer(const state &s, const coor_mask &needed) {
+	state new_state;
+
+	// The needed coordinates are dispatched dynamically, the largest sums first
+	std::vector<size_t> costs(320, 0);
+	for(uint i = 0; i < 5; i++) {
+		for(uint j = 0; j < 64; j++) {
+			if(needed[(i * 64) + j]) {
+				costs[(i * 64) + j] = s[(i * 64) + j].size() + s[(i * 64) + ((j + shifts[i * 2]) % 64)].size()
+				                      + s[(i * 64) + ((j + shifts[(i * 2) + 1]) % 64)].size();
+			}
+		}
+	}
+	const std::vector<uint> order = largest_first(costs);
+
+	std::vector<double> busy(omp_get_max_threads(), 0);
+	const double start = omp_get_wtime();
+
+#pragma omp parallel for schedule(dynamic, 1) default(none) shared(s, new_state, needed, shifts, order, busy)
+	for(uint k = 0; k < 320; k++) {
+		const double start_coor = omp_get_wtime();
+		const uint cur = order[k];
+		const uint i = cur / 64;
+		const uint j = cur % 64;
+		if(needed[cur])
+			add_coors({&s[cur], &s[(i * 64) + ((j + shifts[i * 2]) % 64)], &s[(i * 64) + ((j + shifts[(i * 2) + 1]) % 64)]}, new_state[cur]);
+		busy[omp_get_thread_num()] += omp_get_wtime() - start_coor;
+	}
+	layer_idle.add(busy, omp_get_wtime() - start);
+	return new_state;
+}
+
+
+/*
+ * Returns the coordinates before the linear layer which are needed to compute
+ * the coordinates in needed after the linear layer.
+ */
+inline const coor_mask lin_layer_cone(const coor_mask &needed) {
+	coor_mask cone;
+	for(uint cur = 0; cur < 320; cur++) {
+		if(needed[cur]) {
+			const uint i = cur / 64;
+			const uint j = cur % 64;
+			cone.set(cur);
+			cone.set((i * 64) + ((j + shifts[i * 2]) % 64));
+			cone.set((i * 64) + ((j + shifts[(i * 2) + 1]) % 64));
+		}
+	}
+	return cone;
+}
+
+
+/*
+ * Returns the coordinates before the S-box layer which are needed to compute
+ * the coordinates in needed after the S-box layer.
+ */
+inline const coor_mask sbox_cone(const coor_mask &needed, const bool &quadratic) {
+	const std::array<uint, 5> &inputs = quadratic ? sbox_inputs_quadratic : sbox_inputs_true;
+	coor_mask cone;
+	for(uint j = 0; j < 64; j++) {
+		uint rows = 0;
+		for(uint i = 0; i < 5; i++) {
+			if(needed[(i * 64) + j])
+				rows |= inputs[i];
+		}
+		for(uint i = 0; i < 5; i++) {
+			if((rows >> i) & 1)
+				cone.set((i * 64) + j);
+		}
+	}
+	return cone;
+}
+
+
+/*
+ * Returns the backward dependency cone of a set of coordinates after L4, i.e.
+ * the coordinates of s1, l1, s2, l2, s3, l3, s4 and l4 (in this order, for 4
+ * rounds) which have to be computed to obtain the coordinates in needed.
+ * With last < 2 * nb_rounds - 1, needed are coordinates after the layer last
+ * (see apply_layer) instead, and the masks of the next layers are empty.
+ */
+template<typename S>
+const layer_masks<S> backward_cone(const coor_mask &needed, const uint &last = 2 * S::nb_rounds - 1) {
+	layer_masks<S> cone;
+	cone[last] = needed;
+	for(uint k = last; k > 0; k--) {
+		if(k % 2) // l_r, computed by a linear layer from s_r
+			cone[k - 1] = lin_layer_cone(cone[k]);
+		else // s_r, computed by an S-box layer from l_{r-1}
+			cone[k - 1] = sbox_cone(cone[k], S::quadratic_rounds[k / 2]);
+	}
+
+	std::cout << "cone:";
+	for(const auto &c: cone)
+		std::cout << " " << c.count();
+	std::cout << std::endl;
+	return cone;
+}
+
+
+// Name of the layer "layer" in the outputs: s1, l1, s2, ...
+inline const std::string layer_name(const uint &layer) {
+	std::string name = (layer % 2) ? "l" : "s";
+	return name.append(std::to_string(layer / 2 + 1));
+}
+
+
+/*
+ * Applies the layer "layer" of the first rounds to s (0 for S1, 1 for L1,
+ * ..., 7 for L4 with 4 rounds). Only the coordinates in needed are computed.
+ * The S-box layers without degree filter do not test the products at all.
+ */
+template<typename S>
+state apply_layer(const state &s, const uint &layer, const coor_mask &needed) {
+	if(layer % 2)
+		return lin_layer(s, needed);
+	const degree_set degs = S::sbox_degrees[layer / 2];
+	if(degs == all_degrees)
+		return sbox_state(s, S::quadratic_rounds[layer / 2], no_filter(), needed);
+	return sbox_state(s, S::quadratic_rounds[layer / 2], degree_filter{degs}, needed);
+}
+
+
+/*
+ * Returns the state after the third linear layer (the one before the last
+ * S-box layer of the first rounds) from a given initial state.
+ * Only the coordinates in the given backward cone are computed.
+ */
+template<typename S>
+state build_state_l3(const state &start, const layer_masks<S> &cone) {
+	static_assert(S::nb_rounds >= 2, "l3 is taken before the last S-box layer of the first rounds");
+	// Each state is released as soon as the next one is computed, so that at
+	// most two of them are alive at the same time.
+	size_t released = 0;
+
+	state cur = apply_layer<S>(start, 0, cone[0]);
+	print_len(cur, layer_name(0));
+	for(uint layer = 1; layer + 2 < cone.size(); layer++) {
+		released += state_bytes(cur);
+		cur = apply_layer<S>(cur, layer, cone[layer]);
+		print_len(cur, layer_name(layer));
+	}
+
+	std::cout << "intermediate states released early: " << (released >> 20) << "MB" << std::endl;
+	print_idle(layer_name(cone.size() - 3));
+	return cur;
+}
+
+
+/*
+ * Returns the coordinates in s4_needed of the state after the fourth S-box
+ * layer, from the state after the third linear layer.
+ */
+template<typename S>
+state build_state_s4(const state &l3, const coor_mask &s4_needed) {
+	return apply_layer<S>(l3, 2 * S::nb_rounds - 2, s4_needed);
+}
+
+
+/*
+ * Returns the state after the fourth linear layer from a given initial state.
+ * Only the coordinates in l4_needed, and the ones they depend on, are computed.
+ */
+template<typename S>
+state build_state_l4(const state &start, const coor_mask &l4_needed) {
+	const layer_masks<S> cone = backward_cone<S>(l4_needed);
+	const state s4 = build_state_s4<S>(build_state_l3<S>(start, cone), cone[cone.size() - 2]);
+	print_len(s4, layer_name(cone.size() - 2));
+	const state l4 = lin_layer(s4, cone.back());
+	print_len(l4, layer_name(cone.size() - 1));
+	print_idle(layer_name(cone.size() - 2) + "-" + layer_name(cone.size() - 1));
+
+	return l4;
+}
+
+#endif /* ANF_ROUNDS_1_TO_4_HPP */
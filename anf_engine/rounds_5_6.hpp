@@ -0,0 +1,1026 @@
+/*
+ * Practical cube-attack against nonce-misused ASCON
+ * Filename : rounds_5_6.hpp
+ * Content : Products of THE LAST 2 ROUNDS of ASCON leading to row 0 after S6,
+ *           for polynomials in v_i with coefficients in a ring R (see
+ *           rings.hpp) and the degree schedule S (see rounds_1_to_4.hpp).
+ *           The computation is not exhaustive, it only computes the part of the
+ *           ANF which is needed.
+ *
+ * The polynomials after L4 and after S5 can be stored in any container with
+ * the methods for_each(f), calling f(monomial, coefficient) on each term, and
+ * find(monomial), returning a pointer to the coefficient or nullptr (e.g.
+ * layered_poly or stored_poly), as well as in a std::map for those after L4.
+ * The products after S5 also provide sorted_terms(), their terms sorted by
+ * monomial unless they are dense.
+*/
+
+#ifndef ANF_ROUNDS_5_6_HPP
+#define ANF_ROUNDS_5_6_HPP
+
+#include <bit>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <tuple>
+#include "l4.hpp"
+#include "dense_layer.hpp"
+#include "hash_poly.hpp"
+#include "popcount_filter.hpp"
+#include "covering_index.hpp"
+
+using size_2_products = std::array<uint, 3>;
+using generic_size_2_products = std::array<uint, 2>;
+using trails = std::pair<uint, uint>;
+
+/*
+ * Products of size 2 after S5 and trails of size 4 leading to an output row
+ * after S6 through 1.5 round, for column 0 (the other columns are rotations).
+ * - products: {x, y1, y2} is the product of rows y1 and y2 after L4 in column x,
+ *   sorted.
+ * - pairs: the trails, as the indexes in products of their two products.
+ * - generic_products: the pairs of rows {y1, y2} of the products, sorted, and
+ *   generic_index[y1][y2] the position of {y1, y2} among them.
+ */
+struct trail_table {
+	std::array<size_2_products, 64> products = {};
+	uint nb_products = 0;
+	std::array<trails, 256> pairs = {};
+	uint nb_trails = 0;
+	std::array<generic_size_2_products, 10> generic_products = {};
+	uint nb_generic_products = 0;
+	std::array<std::array<uint, 5>, 5> generic_index = {};
+};
+
+
+/*
+ * Derives the trail_table of the output row "row" from the quadratic terms of
+ * the S-box and the rotations of the linear layer.
+ * The terms of degree 4 in the coordinates after L4 of row after S6 come from
+ * the quadratic terms y_a * y_b of the S-box in S6. After L5, y_a is the sum of
+ * the rows a after S5 in 3 columns, whose quadratic terms are products of size
+ * 2. A trail multiplies a product of y_a and a product of y_b, and is only kept
+ * if its 4 coordinates after L4 are distinct (the degree is too low otherwise)
+ * and if it appears an odd number of times.
+ */
+constexpr trail_table make_trail_table(const uint &row) {
+	// Products of size 2 met on the way, and parity of their pairs
+	std::array<size_2_products, 64> met = {};
+	uint nb_met = 0;
+	std::array<std::array<bool, 64>, 64> odd = {};
+	const auto met_index = [&](const size_2_products &p) {
+		for(uint i = 0; i < nb_met; i++) {
+			if(met[i] == p)
+				return i;
+		}
+		met[nb_met] = p;
+		return nb_met++;
+	};
+	const auto columns = [](const uint &a) {return std::array<uint, 3>{0, shifts[2 * a], shifts[(2 * a) + 1]};};
+
+	for(const auto &ab: sbox_quadratic_terms[row]) {
+		if(!ab)
+			continue;
+		const uint a = std::countr_zero(ab);
+		const uint b = std::bit_width(ab) - 1;
+		for(const auto &x1: columns(a)) {
+			for(const auto &t1: sbox_quadratic_terms[a]) {
+				for(const auto &x2: columns(b)) {
+					for(const auto &t2: sbox_quadratic_terms[b]) {
+						if(!t1 || !t2 || (x1 == x2 && (t1 & t2)))
+							continue;
+						const uint i = met_index({x1, (uint) std::countr_zero(t1), (uint) std::bit_width(t1) - 1});
+						const uint j = met_index({x2, (uint) std::countr_zero(t2), (uint) std::bit_width(t2) - 1});
+						odd[std::min(i, j)][std::max(i, j)] ^= true;
+					}
+				}
+			}
+		}
+	}
+
+	// Products appearing in a trail, sorted
+	trail_table t;
+	for(uint i = 0; i < nb_met; i++) {
+		for(uint j = 0; j < nb_met; j++) {
+			if(odd[i][j] || odd[j][i]) {
+				t.products[t.nb_products++] = met[i];
+				break;
+			}
+		}
+	}
+	std::sort(t.products.begin(), t.products.begin() + t.nb_products);
+	const auto product_position = [&t](const size_2_products &p) {
+		return (uint) (std::find(t.products.begin(), t.products.begin() + t.nb_products, p) - t.products.begin());
+	};
+
+	for(uint i = 0; i < nb_met; i++) {
+		for(uint j = i + 1; j < nb_met; j++) {
+			if(odd[i][j])
+				t.pairs[t.nb_trails++] = {std::min(product_position(met[i]), product_position(met[j])), std::max(product_position(met[i]), product_position(met[j]))};
+		}
+	}
+	std::sort(t.pairs.begin(), t.pairs.begin() + t.nb_trails);
+
+	for(uint k = 0; k < t.nb_products; k++) {
+		const generic_size_2_products g = {t.products[k][1], t.products[k][2]};
+		if(std::find(t.generic_products.begin(), t.generic_products.begin() + t.nb_generic_products, g) == t.generic_products.begin() + t.nb_generic_products)
+			t.generic_products[t.nb_generic_products++] = g;
+	}
+	std::sort(t.generic_products.begin(), t.generic_products.begin() + t.nb_generic_products);
+	for(uint k = 0; k < t.nb_generic_products; k++)
+		t.generic_index[t.generic_products[k][0]][t.generic_products[k][1]] = k;
+	return t;
+}
+
+// Trail tables of the 5 output rows
+inline constexpr std::array<trail_table, 5> trail_tables = {make_trail_table(0), make_trail_table(1), make_trail_table(2), make_trail_table(3), make_trail_table(4)};
+
+// Output row targeted by the attack: the only one ASCON outputs
+// (tests/trail_table_test.cpp compares its table with the former hand-written lists)
+inline constexpr uint target_row = 0;
+static_assert(trail_tables[target_row].nb_products == 22 && trail_tables[target_row].nb_trails == 121, "22 products and 121 trails lead to row 0");
+
+// List of products of size 2 appearing in at least one trail of size 4
+inline const std::vector<size_2_products> list_products(trail_tables[target_row].products.begin(),
+                                                        trail_tables[target_row].products.begin() + trail_tables[target_row].nb_products);
+
+// List of trails of size 4 leading to coordinate c_{target_row,0} through 1.5 round
+inline const std::vector<trails> list_trails(trail_tables[target_row].pairs.begin(),
+                                             trail_tables[target_row].pairs.begin() + trail_tables[target_row].nb_trails);
+
+// List of the necessary products occurring during S5 in each column.
+// Each generic_size_2_products corresponds to the indexes of two rows multiplied through ASCON S-box.
+// The list is not exhaustive as not all products appear in the 1.5-round trails leading to the target row.
+inline const std::vector<generic_size_2_products> list_generic_products(trail_tables[target_row].generic_products.begin(),
+                                                                        trail_tables[target_row].generic_products.begin() + trail_tables[target_row].nb_generic_products);
+
+
+/*
+ * Prints the number of products of size 2 and of trails leading to each output
+ * row, i.e. the cost of the last 1.5 round for a cube on this row.
+ */
+inline void print_trail_tables() {
+	for(uint row = 0; row < 5; row++) {
+		std::cout << "Output row " + std::to_string(row) + ": " + std::to_string(trail_tables[row].nb_products) + " products of size 2, "
+		             + std::to_string(trail_tables[row].nb_trails) + " trails" + ((row == target_row) ? " (targeted)" : "") + "\n";
+	}
+}
+
+
+template<typename coeff_t, typename F>
+void for_each_term(const std::map<uint64_t, coeff_t> &p, F f) {
+	for(const auto &[monom, coeff]: p)
+		f(monom, coeff);
+}
+
+template<typename poly_t, typename F>
+void for_each_term(const poly_t &p, F f) {
+	p.for_each(f);
+}
+
+template<typename coeff_t>
+const coeff_t *find_term(const std::map<uint64_t, coeff_t> &p, const uint64_t &m) {
+	const auto it = p.find(m);
+	return (it == p.end()) ? nullptr : &(it->second);
+}
+
+template<typename poly_t>
+auto find_term(const poly_t &p, const uint64_t &m) {
+	return p.find(m);
+}
+
+
+/*
+ * Calls f on the subsets of k variables of the monomial m.
+ */
+template<typename F>
+void for_each_subset(const uint64_t &m, const uint &k, F f) {
+	const uint n = __builtin_popcountll(m);
+	if(k > n)
+		return;
+	if(k == 0) {
+		f((uint64_t) 0);
+		return;
+	}
+	const uint64_t first = (k == 64) ? ~((uint64_t) 0) : ((((uint64_t) 1) << k) - 1);
+	const uint64_t last = first << (n - k);
+	for(uint64_t c = first; ; c = next_combination(c)) {
+		f(deposit_monom(c, m));
+		if(c == last)
+			return;
+	}
+}
+
+
+// Term of a polynomial: its monomial in v_i and a pointer to its coefficient
+template<typename coeff_t>
+using term_ref = std::pair<uint64_t, const coeff_t *>;
+
+
+/*
+ * Sorts the terms by monomial, their monomials being in the variables of vars.
+ * The monomials are compressed to these variables, which keeps their order,
+ * and sorted by a radix sort on 11 bits at a time using buffer (3 passes for
+ * the monomials of a cube of degree 32).
+ */
+template<typename coeff_t>
+void sort_terms(std::vector<term_ref<coeff_t>> &terms, std::vector<term_ref<coeff_t>> &buffer, const uint64_t &vars) {
+	constexpr uint radix_bits = 11;
+	const uint nb_vars = __builtin_popcountll(vars);
+	if(nb_vars > 3 * radix_bits || terms.size() < 256) {
+		std::sort(terms.begin(), terms.end(), [](const term_ref<coeff_t> &t1, const term_ref<coeff_t> &t2) {return t1.first < t2.first;});
+		return;
+	}
+	buffer.resize(terms.size());
+	for(uint shift = 0; shift < nb_vars; shift += radix_bits) {
+		std::array<size_t, (1 << radix_bits) + 1> count = {};
+		for(const auto &t: terms)
+			count[((compress_monom(t.first, vars) >> shift) & ((1 << radix_bits) - 1)) + 1]++;
+		for(size_t i = 1; i < count.size(); i++)
+			count[i] += count[i - 1];
+		for(const auto &t: terms)
+			buffer[count[(compress_monom(t.first, vars) >> shift) & ((1 << radix_bits) - 1)]++] = t;
+		terms.swap(buffer);
+	}
+}
+
+
+// Scratch space of join_terms: the monomials of a range of terms and the indices selected among them
+struct join_buffer {
+	std::vector<uint64_t> keys;
+	std::vector<uint32_t> selected;
+};
+
+
+/*
+ * Calls f(t1, t2) on the pairs of terms of [a, a_end) x [b, b_end) whose
+ * monomials share at most k of the variables in vars (the other variables
+ * being already accounted in k).
+ * Both ranges are split on a variable of vars: the pairs of terms which both
+ * contain it only remain candidates with one shared variable less, and are
+ * skipped when none is left. For small ranges, the monomials of [b, b_end)
+ * are copied to a contiguous array and, for each term of [a, a_end), those
+ * sharing at most k variables are selected by a vectorized kernel (see
+ * popcount_filter.hpp) before f is called on them.
+ * The terms are reordered inside their range.
+ */
+template<typename coeff_t, typename F>
+void join_terms(term_ref<coeff_t> *a, term_ref<coeff_t> *a_end, term_ref<coeff_t> *b, term_ref<coeff_t> *b_end,
+                const uint64_t &vars, const uint &k, F &f, join_buffer &buffer) {
+	if(a == a_end || b == b_end)
+		return;
+	if(!vars || (a_end - a) * (b_end - b) <= 4096) {
+		const size_t n = b_end - b;
+		buffer.keys.resize(n);
+		buffer.selected.resize(n);
+		for(size_t j = 0; j < n; j++)
+			buffer.keys[j] = b[j].first & vars;
+		for(auto x = a; x != a_end; x++) {
+			const size_t nb_selected = select_sharing_at_most(x->first, buffer.keys.data(), n, k, buffer.selected.data());
+			for(size_t j = 0; j < nb_selected; j++)
+				f(*x, b[buffer.selected[j]]);
+		}
+		return;
+	}
+
+	const uint64_t v = vars & (~vars + 1);
+	const auto without_v = [&v](const term_ref<coeff_t> &t) {return !(t.first & v);};
+	term_ref<coeff_t> *a_v = std::partition(a, a_end, without_v);
+	term_ref<coeff_t> *b_v = std::partition(b, b_end, without_v);
+	join_terms(a, a_v, b, b_v, vars ^ v, k, f, buffer);
+	join_terms(a, a_v, b_v, b_end, vars ^ v, k, f, buffer);
+	join_terms(a_v, a_end, b, b_v, vars ^ v, k, f, buffer);
+	if(k)
+		join_terms(a_v, a_end, b_v, b_end, vars ^ v, k - 1, f, buffer);
+}
+
+
+/*
+ * Computes a partial multiplication between two coordinates after L4 and returns a poly_map.
+ * It is expected that c1 and c2 are two polynomials with terms of the degrees kept by S4,
+ * as output by get_l4.
+ * It only returns the terms of degree S::s5_min to S::s5_max that appears in the product.
+ *
+ * Two terms of degree d1 and d2 give a product of degree at least S::s5_min only if
+ * they share at most d1 + d2 - S::s5_min variables (none for degree-8 terms in phase 2,
+ * one for two degree-8 terms in phase 3): the terms are grouped by degree, and only these
+ * pairs are enumerated (see join_terms) instead of all of them.
+ * The product is accumulated in a hash table (see hash_poly.hpp), by batches of
+ * terms whose slots are prefetched together.
+ *
+ * Only the terms of c1 and c2 whose monomial is a subset of target are read, i.e. the
+ * variables v_i out of target are set to 0. Setting a variable to 0 commutes with the
+ * products and with the degree windows of the schedule, which only select monomials:
+ * the coordinates after L4 computed from a superset of the cube (its columns holding v_i
+ * in the initial state) thus give the products of the cube alone, and one computation
+ * of l4 serves all the sub-cubes of the superset, without any copy.
+ * This assumes that the other rows of the initial state do not depend on the cube, or
+ * only in columns whose terms of degree 0 in v_i after S1 never reach the kept degrees
+ * (as with drop = 0, where only the terms of degree 1 after S1 do).
+ *
+ * This function corresponds to the computation of the interesting terms during S5.
+ */
+template<typename R, typename S, typename poly_t>
+poly_map_in<R> multiply_maps_S5(const poly_t &c1, const poly_t &c2, const uint64_t &target) {
+	using coeff_t = typename R::coeff;
+	hash_poly<coeff_t> prod; // Output product, returned as a poly_map
+
+	// Terms of c1 and c2 by degree
+	std::array<std::vector<term_ref<coeff_t>>, 65> terms1;
+	std::array<std::vector<term_ref<coeff_t>>, 65> terms2;
+	uint64_t vars = 0;
+	for_each_term(c1, [&](const uint64_t &monom, const coeff_t &coeff) {
+		if(!(monom & ~target)) {
+			terms1[__builtin_popcountll(monom)].emplace_back(monom, &coeff);
+			vars |= monom;
+		}
+	});
+	for_each_term(c2, [&](const uint64_t &monom, const coeff_t &coeff) {
+		if(!(monom & ~target)) {
+			terms2[__builtin_popcountll(monom)].emplace_back(monom, &coeff);
+			vars |= monom;
+		}
+	});
+
+	// Products of two terms, restricted by the degrees kept after S5. They are
+	// added by batches, whose slots in prod are prefetched first.
+	std::array<std::tuple<uint64_t, const coeff_t *, const coeff_t *>, 16> batch;
+	uint batch_size = 0;
+	auto flush = [&]() {
+		for(uint i = 0; i < batch_size; i++)
+			prod.prefetch(std::get<0>(batch[i]));
+		for(uint i = 0; i < batch_size; i++) {
+			const auto &[monom, coeff1, coeff2] = batch[i];
+			R::add(prod.find_or_insert(monom), R::mul(*coeff1, *coeff2));
+		}
+		batch_size = 0;
+	};
+	auto multiply = [&](const term_ref<coeff_t> &t1, const term_ref<coeff_t> &t2) {
+		const uint64_t tmp_monom = (t1.first | t2.first); // Multiplication of two monomials is an OR
+		const uint d = __builtin_popcountll(tmp_monom);
+		if(d >= S::s5_min && d <= S::s5_max) {
+			batch[batch_size++] = {tmp_monom, t1.second, t2.second};
+			if(batch_size == batch.size())
+				flush();
+		}
+	};
+	join_buffer buffer;
+	for(uint d1 = 0; d1 <= 64; d1++) {
+		for(uint d2 = 0; d2 <= 64; d2++) {
+			if(d1 + d2 >= S::s5_min && !terms1[d1].empty() && !terms2[d2].empty())
+				join_terms(terms1[d1].data(), terms1[d1].data() + terms1[d1].size(), terms2[d2].data(), terms2[d2].data() + terms2[d2].size(),
+				           vars, d1 + d2 - S::s5_min, multiply, buffer);
+		}
+	}
+	flush();
+	return prod.to_map();
+}
+
+
+/*
+ * Calls f(coeff1, coeff2) on the pairs of a query {key, coeff1} of [q, q_end), sorted
+ * by key, and of a term {key, coeff2} of terms, sorted by monomial.
+ * Both are walked in a single pass: from the term matching a query, the next
+ * query's term is reached by steps doubling in size, then a binary search. The
+ * pass thus reads terms sequentially when the queries are about as many as the
+ * terms, and skips over most of them when the queries are much fewer.
+ */
+template<typename coeff_t, typename term_t, typename F>
+void merge_terms(const term_ref<coeff_t> *q, const term_ref<coeff_t> *q_end, std::span<const term_t> terms, F f) {
+	size_t j = 0;
+	const size_t n = terms.size();
+	for(; q != q_end && j < n; q++) {
+		if(terms[j].monom < q->first) {
+			size_t step = 1;
+			while(j + step < n && terms[j + step].monom < q->first)
+				step *= 2;
+			j = std::lower_bound(terms.begin() + j + step / 2 + 1, terms.begin() + std::min(j + step, n), q->first,
+			                     [](const term_t &t, const uint64_t &x) {return t.monom < x;}) - terms.begin();
+		}
+		if(j < n && terms[j].monom == q->first)
+			f(*(q->second), terms[j].coeff);
+	}
+}
+
+
+/*
+ * Monomials queried by S6, those ruled out by a Bloom filter, and those found.
+ */
+struct s6_lookups {
+	size_t queries = 0;
+	size_t filtered = 0;
+	size_t hits = 0;
+
+	void add(const s6_lookups &other) {
+		queries += other.queries;
+		filtered += other.filtered;
+		hits += other.hits;
+	}
+
+	void print() const {
+		const size_t absent = queries - hits;
+		std::cout << "S6 lookups: " + std::to_string(queries) + ", " + std::to_string(hits) + " hits (" + std::to_string(queries ? (100 * hits) / queries : 0)
+		             + "%), " + std::to_string(filtered) + " misses skipped by the filters (" + std::to_string(absent ? (100 * filtered) / absent : 100) + "% of the misses)\n";
+	}
+};
+
+
+/*
+ * Computes a partial multiplication between two products of size 2 and returns a coefficient.
+ * It is expected that c1 and c2 are two polynomials with terms of degree S::s5_min to S::s5_max,
+ * as output by multiply_maps_S5.
+ * It only returns the coefficient (that appears in the product c1*c2) corresponding to the target monomial given as input.
+ *
+ * For each term monom1 of the smallest polynomial, the terms monom2 of the other one such that
+ * monom1*monom2 = target are the complement of monom1 in target, together with any subset of
+ * the variables of monom1. Only the subsets which keep the degree of monom2 between S::s5_min
+ * and S::s5_max are queried, e.g. none when all the terms have degree |target|/2 and only one
+ * variable of monom1 for the terms of degree |target|/2 in phase 3.
+ * The queries are collected by batches, sorted, and merged against the other polynomial when
+ * its terms are sorted by monomial (in memory or spilled, see merge_terms), which replaces
+ * one random lookup per query by a sequential pass. Dense polynomials are looked up directly.
+ * Most queries miss: they are first checked against the Bloom filter of the other polynomial,
+ * and only those which pass it are sorted and looked up. They are counted in lookups.
+ * When the other polynomial has a covering index (cover1 for c1, cover2 for c2, see
+ * covering_index.hpp), the subsets of one variable are all found by a single query of the
+ * complement in the index, instead of one query per variable of monom1.
+ *
+ * This function corresponds to the computation of a coefficient of the target monomial after S6.
+ */
+template<typename R, typename S, typename product_t>
+typename R::coeff multiply_maps_S6(const product_t &c1, const product_t &c2, const uint64_t &target, s6_lookups &lookups,
+                                   const covering_index &cover1 = covering_index(), const covering_index &cover2 = covering_index()) {
+	using coeff_t = typename R::coeff;
+	typename R::coeff prod = R::zero(); // Output coefficient
+
+	// Select the smallest list to be browsed
+	const product_t * first = &c1;
+	const product_t * second = &c2;
+	const covering_index * cover = &cover2;
+	if(c2.size() < c1.size()) {
+		first = &c2;
+		second = &c1;
+		cover = &cover1;
+	}
+
+	const auto sorted = second->sorted_terms();
+	auto multiply = [&](const coeff_t &coeff1, const coeff_t &coeff2) {
+		lookups.hits++;
+		if(!R::is_zero(coeff2))
+			R::add(prod, R::mul(coeff1, coeff2));
+	};
+
+	// Queries {complementary monomial, coefficient of monom1}, by batches
+	constexpr size_t batch_size = ((size_t) 1) << 16;
+	std::vector<term_ref<coeff_t>> queries;
+	std::vector<term_ref<coeff_t>> covered; // Complements queried in the covering index
+	std::vector<term_ref<coeff_t>> buffer;
+	queries.reserve(std::min(batch_size, 2 * first->size()));
+	auto flush = [&]() {
+		sort_terms(queries, buffer, target);
+		if(!sorted.empty())
+			merge_terms(queries.data(), queries.data() + queries.size(), sorted, multiply);
+		else {
+			for(const auto &[monom2, coeff1]: queries) {
+				const auto *coeff2 = find_term(*second, monom2);
+				if(coeff2 != nullptr)
+					multiply(*coeff1, *coeff2);
+			}
+		}
+		queries.clear();
+
+		sort_terms(covered, buffer, target);
+		cover->for_each_cover(covered.data(), covered.data() + covered.size(), [&](const term_ref<coeff_t> &q, const uint64_t &monom2) {
+			const auto *coeff2 = find_term(*second, monom2);
+			if(coeff2 != nullptr)
+				multiply(*(q.second), *coeff2);
+		});
+		covered.clear();
+	};
+
+	for_each_term(*first, [&](const uint64_t &monom1, const coeff_t &coeff1) { // Loop over the smallest list
+		if(R::is_zero(coeff1) || (monom1 & ~target)) // If monom1 does not actually appear, or cannot divide the target
+			return;
+		const uint64_t complement = ((~monom1) & target);
+		const uint d = __builtin_popcountll(complement);
+
+		for(uint k = (S::s5_min > d) ? S::s5_min - d : 0; d + k <= S::s5_max; k++) {
+			if(k == 1 && !cover->empty()) {
+				lookups.queries++;
+				covered.emplace_back(complement, &coeff1);
+				continue;
+			}
+			for_each_subset(monom1, k, [&](const uint64_t &shared) {
+				lookups.queries++;
+				if(second->might_contain(complement | shared))
+					queries.emplace_back(complement | shared, &coeff1);
+				else
+					lookups.filtered++;
+			});
+		}
+		if(queries.size() + covered.size() >= batch_size)
+			flush();
+	});
+	flush();
+	return prod;
+}
+
+
+/*
+ * Returns the sum of coeffs, which are added pairwise in parallel, level by
+ * level of a binary tree. The additions and their order only depend on the
+ * number of coefficients, not on the number of threads. coeffs is emptied.
+ */
+template<typename R>
+typename R::coeff sum_coefficients(std::vector<typename R::coeff> &coeffs) {
+	if(coeffs.empty())
+		return R::zero();
+	for(size_t step = 1; step < coeffs.size(); step *= 2) {
+#pragma omp parallel for default(none) shared(coeffs, step)
+		for(size_t i = 0; i < coeffs.size() - step; i += 2 * step) {
+			R::add(coeffs[i], coeffs[i + step]);
+			coeffs[i + step] = R::zero();
+		}
+	}
+	typename R::coeff sum = std::move(coeffs[0]);
+	coeffs.clear();
+	return sum;
+}
+
+
+/*
+ * Prints how many products of size 2 are stored densely.
+ */
+template<typename product_t>
+void print_dense_products(const std::vector<const product_t *> &products) {
+	uint nb_dense = 0;
+	for(const auto &prod: products)
+		nb_dense += prod->is_dense();
+	std::cout << "Dense products: " + std::to_string(nb_dense) + "/" + std::to_string(products.size()) + "\n";
+}
+
+
+/*
+ * Returns the coordinates of l4 read by coefficient_recovery for the output
+ * columns in cols, i.e. the operands of the products of size 2 in each column.
+ */
+inline const coor_mask l4_needed_for_columns(const std::set<uint> &cols) {
+	coor_mask needed;
+	for(const auto &col: cols) {
+		for(const auto &[x, y1, y2]: list_products) {
+			needed.set(y1 * 64 + ((x + col) % 64));
+			needed.set(y2 * 64 + ((x + col) % 64));
+		}
+	}
+	return needed;
+}
+
+
+// Position of the rows of p in list_generic_products
+inline uint generic_product_index(const size_2_products &p) {
+	return trail_tables[target_row].generic_index[p[1]][p[2]];
+}
+
+
+/*
+ * Products of size 2 after S5 shared between the output columns: the product
+ * of rows y1 and y2 in column j is read by every output column col such that
+ * some (x, y1, y2) of list_products has (x + col) % 64 = j.
+ * A product is computed by the first column which needs it, and released once
+ * the last of the columns given to init_product_table which need it is done
+ * or cancelled.
+ */
+template<typename product_t>
+struct product_table {
+	std::array<std::vector<product_t>, 64> products;
+	std::array<std::vector<covering_index>, 64> covering; // Covering indexes of the products, when S6 uses them
+	std::array<std::vector<bool>, 64> computed;
+	std::array<std::vector<uint>, 64> pending; // Number of columns still to come which need each product
+	size_t nb_computed = 0;
+	size_t total_bytes = 0; // Size of the nb_computed products when they were computed
+	size_t computed_bytes = 0; // Size of the products currently in the table
+};
+
+
+/*
+ * Bytes taken in memory by the product of size 2 of index i in
+ * list_generic_products in column j, covering index included.
+ */
+template<typename product_t>
+size_t product_bytes(const product_table<product_t> &table, const uint &j, const uint &i) {
+	return table.products[j][i].bytes() + table.covering[j][i].bytes();
+}
+
+
+/*
+ * Counts the product of index i in column j, which has just been computed, in
+ * the sizes of table. Safe to call from concurrent tasks.
+ */
+template<typename product_t>
+void count_product(product_table<product_t> &table, const uint &j, const uint &i) {
+	const size_t bytes = product_bytes(table, j, i);
+#pragma omp atomic
+	table.total_bytes += bytes;
+#pragma omp atomic
+	table.computed_bytes += bytes;
+}
+
+
+/*
+ * Frees the product of index i in column j and its covering index.
+ */
+template<typename product_t>
+void release_product(product_table<product_t> &table, const uint &j, const uint &i) {
+	const size_t bytes = product_bytes(table, j, i);
+#pragma omp atomic
+	table.computed_bytes -= bytes;
+	table.products[j][i] = product_t();
+	table.covering[j][i] = covering_index();
+}
+
+
+/*
+ * Returns an empty table of products for the output columns in cols.
+ */
+template<typename product_t>
+product_table<product_t> init_product_table(const std::set<uint> &cols) {
+	product_table<product_t> table;
+	for(uint j = 0; j < 64; j++) {
+		table.products[j].resize(list_generic_products.size());
+		table.covering[j].resize(list_generic_products.size());
+		table.computed[j].resize(list_generic_products.size(), false);
+		table.pending[j].resize(list_generic_products.size(), 0);
+	}
+	for(const auto &col: cols) {
+		for(const auto &p: list_products)
+			table.pending[(p[0] + col) % 64][generic_product_index(p)]++;
+	}
+	return table;
+}
+
+
+/*
+ * Returns the products of size 2 read by the output columns in cols, as pairs
+ * (column, position in list_generic_products).
+ */
+inline const std::set<std::pair<uint, uint>> products_of_columns(const std::set<uint> &cols) {
+	std::set<std::pair<uint, uint>> products;
+	for(const auto &col: cols) {
+		for(const auto &p: list_products)
+			products.emplace((p[0] + col) % 64, generic_product_index(p));
+	}
+	return products;
+}
+
+
+/*
+ * Estimated cost of the product of size 2 of index i in list_generic_products
+ * in column j: the number of pairs of terms of its operands.
+ */
+template<typename l4_poly_t>
+size_t product_cost(const uint &j, const uint &i, const std::array<l4_poly_t, 320> &l4) {
+	const auto &[y1, y2] = list_generic_products[i];
+	return l4[y1 * 64 + j].size() * l4[y2 * 64 + j].size();
+}
+
+
+/*
+ * Computes the product of size 2 of index i in list_generic_products in column
+ * j, and stores it in table.
+ */
+template<typename R, typename S, typename product_t, typename l4_poly_t>
+void compute_product(const uint &j, const uint &i, const std::array<l4_poly_t, 320> &l4, const uint64_t &target,
+                     product_table<product_t> &table) {
+	const auto &[y1, y2] = list_generic_products[i];
+	std::cout << "Prod col " + std::to_string(j) + " [" + std::to_string(y1) + ", " + std::to_string(y2) +  "] - Nb checks:" + std::to_string(product_cost(j, i, l4) / 1000000) + "M\n";
+	table.products[j][i] = product_t(multiply_maps_S5<R, S>(l4[y1 * 64 + j], l4[y2 * 64 + j], target), target);
+
+	// S6 looks for the terms which overlap another one in a single variable: those of degree at
+	// least target_degree + 1 - s5_max, i.e. none in phase 2 and those of degree s5_max in phase 3
+	constexpr uint cover_degree = std::max<uint>(S::s5_min, S::target_degree + 1 - S::s5_max);
+	if constexpr(cover_degree <= S::s5_max)
+		table.covering[j][i] = covering_index(table.products[j][i], target, cover_degree, S::s5_max);
+}
+
+
+/*
+ * Computes in parallel the products of size 2 read by the output columns in
+ * cols which are not in table yet, the most expensive ones first.
+ */
+template<typename R, typename S, typename product_t, typename l4_poly_t>
+void compute_products(const std::set<uint> &cols, const std::array<l4_poly_t, 320> &l4, const uint64_t &target,
+                      product_table<product_t> &table) {
+	std::vector<std::pair<uint, uint>> missing;
+	for(const auto &[j, i]: products_of_columns(cols)) {
+		if(!table.computed[j][i]) {
+			table.computed[j][i] = true;
+			missing.emplace_back(j, i);
+		}
+	}
+	std::stable_sort(missing.begin(), missing.end(), [&l4](const std::pair<uint, uint> &p1, const std::pair<uint, uint> &p2) {
+		return product_cost(p1.first, p1.second, l4) > product_cost(p2.first, p2.second, l4);
+	});
+
+#pragma omp parallel for default(none) shared(l4, missing, table, target) schedule(dynamic, 1)
+	for(uint k = 0; k < missing.size(); k++)
+		compute_product<R, S>(missing[k].first, missing[k].second, l4, target, table);
+	for(const auto &[j, i]: missing)
+		count_product(table, j, i);
+	table.nb_computed += missing.size();
+}
+
+
+/*
+ * Computes the coefficients of the target monomial in the coordinates c_{0,x} after S6, for the
+ * output columns x of cols, several columns at once.
+ * on_coefficient(x, coefficient) is called on the coefficient of each column, in the order of
+ * cols, once those of the previous columns are known. When it returns false, the next columns
+ * are cancelled: their tasks which have not started yet are skipped. Returns the number of
+ * columns given to on_coefficient.
+ *
+ * - target is the monomial we are targeting.
+ * - l4 is the state after l4, initialized with only the necessary variables.
+ *  It is expected that l4 has been initialized through get_l4 first.
+ * The products of size 2 after S5 are stored as product_t, built from a
+ * poly_map and the variables of target. They are read from table, and only
+ * those which are not there yet are computed (see product_table).
+ */
+template<typename R, typename S, typename product_t, typename l4_poly_t>
+uint coefficient_recovery(const std::vector<uint> &cols, const std::array<l4_poly_t, 320> &l4, const uint64_t &target,
+                          product_table<product_t> &table,
+                          const std::function<bool(const uint &, const typename R::coeff &)> &on_coefficient) {
+	const auto start = std::chrono::high_resolution_clock::now();
+	std::cout << "S5-L5-S6..." << std::endl;
+
+	// Products read by each column, in the order of list_products, as their position (j, i) in the
+	// table packed in j * nb_generic + i
+	const uint nb_generic = list_generic_products.size();
+	std::vector<std::vector<uint>> col_products(cols.size());
+	std::vector<uint> missing; // Products which are not in the table yet
+	std::vector<char> is_missing(64 * nb_generic, false);
+	for(uint c = 0; c < cols.size(); c++) {
+		for(const auto &p: list_products) {
+			const uint j = (p[0] + cols[c]) % 64;
+			const uint i = generic_product_index(p);
+			col_products[c].push_back(j * nb_generic + i);
+			if(!table.computed[j][i]) {
+				table.computed[j][i] = true;
+				is_missing[j * nb_generic + i] = true;
+				missing.push_back(j * nb_generic + i);
+			}
+		}
+	}
+
+	// Estimated cost of the trails in S6: the size of their smallest product, which is
+	// the number of lookups, a product still to compute being rated by its cost in S5.
+	std::vector<size_t> estimated_size(64 * nb_generic);
+	for(const auto &products: col_products) {
+		for(const auto &k: products) {
+			estimated_size[k] = is_missing[k] ? product_cost(k / nb_generic, k % nb_generic, l4)
+			                                  : table.products[k / nb_generic][k % nb_generic].size();
+		}
+	}
+	std::vector<std::vector<uint>> trail_order(cols.size());
+	for(uint c = 0; c < cols.size(); c++) {
+		const auto trail_size = [&estimated_size, &products = col_products[c]](const uint &t) {
+			return std::min(estimated_size[products[list_trails[t].first]], estimated_size[products[list_trails[t].second]]);
+		};
+		for(uint t = 0; t < list_trails.size(); t++)
+			trail_order[c].push_back(t);
+		std::stable_sort(trail_order[c].begin(), trail_order[c].end(), [&trail_size](const uint &t1, const uint &t2) {return trail_size(t1) > trail_size(t2);});
+	}
+
+	std::vector<std::vector<typename R::coeff>> trail_coeffs(cols.size(), std::vector<typename R::coeff>(list_trails.size(), R::zero()));
+	std::vector<std::vector<s6_lookups>> trail_lookups(cols.size(), std::vector<s6_lookups>(list_trails.size()));
+	std::vector<std::atomic<uint>> remaining_trails(cols.size());
+	for(auto &r: remaining_trails)
+		r = list_trails.size();
+	std::vector<typename R::coeff> coeffs(cols.size(), R::zero());
+	std::vector<char> col_done(cols.size(), false);
+	std::vector<char> product_done(64 * nb_generic, false);
+	uint nb_output = 0; // Columns given to on_coefficient
+	std::atomic<bool> cancelled = false;
+
+	// Once the last trail of the column of position c in cols is done: sums its trails, releases the
+	// products no other column needs, and outputs the coefficients of the columns done so far in
+	// the order of cols.
+	const auto column_done = [&](const uint &c) {
+		coeffs[c] = sum_coefficients<R>(trail_coeffs[c]);
+		s6_lookups lookups;
+		for(const auto &l: trail_lookups[c])
+			lookups.add(l);
+#pragma omp critical(column_output)
+		{
+			std::cout << "\nPoly " + std::to_string(cols[c]) + ":\n";
+			std::vector<const product_t *> products;
+			for(const auto &k: col_products[c])
+				products.push_back(&table.products[k / nb_generic][k % nb_generic]);
+			print_dense_products(products);
+			lookups.print();
+			for(const auto &k: col_products[c]) {
+				uint &pending = table.pending[k / nb_generic][k % nb_generic];
+				if(pending && !--pending)
+					release_product(table, k / nb_generic, k % nb_generic);
+			}
+			col_done[c] = true;
+			for(; nb_output < cols.size() && col_done[nb_output] && !cancelled; nb_output++) {
+				if(!on_coefficient(cols[nb_output], coeffs[nb_output]))
+					cancelled = true;
+			}
+		}
+	};
+
+	// STEP 1 : for each product of size 2 which is not in the table yet, computes the product and store it in the table
+	// STEP 2 : for all trails, combine two products of size 2 to obtain a product of size 4
+	// Both steps are tasks, column by column and the most expensive first in a column: a trail
+	// starts as soon as its two products are there, possibly while the other products or the
+	// previous columns are still computed. Each trail writes its own slot, so that no thread waits
+	// on another one.
+	std::vector<char> ready(64 * nb_generic); // Dependencies of the tasks on the products
+	char *ready_product = ready.data();
+	std::vector<char> spawned(64 * nb_generic, false);
+#pragma omp parallel default(none) shared(l4, target, table, cols, nb_generic, col_products, is_missing, estimated_size, trail_order, list_trails, trail_coeffs, trail_lookups, remaining_trails, product_done, spawned, cancelled, column_done, ready_product, std::cout)
+#pragma omp single
+	{
+		for(uint c = 0; c < cols.size(); c++) {
+			std::vector<uint> new_products;
+			for(const auto &k: col_products[c]) {
+				if(is_missing[k] && !spawned[k]) {
+					spawned[k] = true;
+					new_products.push_back(k);
+				}
+			}
+			std::stable_sort(new_products.begin(), new_products.end(), [&estimated_size](const uint &k1, const uint &k2) {return estimated_size[k1] > estimated_size[k2];});
+			for(const auto &k: new_products) {
+#pragma omp task default(none) firstprivate(k) shared(l4, target, table, nb_generic, product_done, cancelled) depend(out: ready_product[k])
+				if(!cancelled) {
+					compute_product<R, S>(k / nb_generic, k % nb_generic, l4, target, table);
+					count_product(table, k / nb_generic, k % nb_generic);
+					product_done[k] = true;
+				}
+			}
+			for(const auto &t: trail_order[c]) {
+				const uint k0 = col_products[c][list_trails[t].first];
+				const uint k1 = col_products[c][list_trails[t].second];
+#pragma omp task default(none) firstprivate(c, t, k0, k1) shared(target, table, nb_generic, trail_coeffs, trail_lookups, remaining_trails, cancelled, column_done, std::cout) depend(in: ready_product[k0], ready_product[k1])
+				if(!cancelled) {
+					const product_t &c1 = table.products[k0 / nb_generic][k0 % nb_generic];
+					const product_t &c2 = table.products[k1 / nb_generic][k1 % nb_generic];
+					if(!c1.empty() && !c2.empty()) {
+						trail_coeffs[c][t] = multiply_maps_S6<R, S>(c1, c2, target, trail_lookups[c][t], table.covering[k0 / nb_generic][k0 % nb_generic],
+						                                            table.covering[k1 / nb_generic][k1 % nb_generic]);
+						std::cout << "|" << std::flush;
+					}
+					if(remaining_trails[c].fetch_sub(1) == 1)
+						column_done(c);
+				}
+			}
+		}
+	}
+	std::cout << std::endl;
+
+	// The cancelled columns no longer need their products: those which were only kept for them
+	// are released, and computed again if a later call asks for them
+	for(uint c = 0; c < cols.size(); c++) {
+		if(col_done[c])
+			continue;
+		for(const auto &k: col_products[c]) {
+			uint &pending = table.pending[k / nb_generic][k % nb_generic];
+			if(pending && !--pending) {
+				release_product(table, k / nb_generic, k % nb_generic);
+				table.computed[k / nb_generic][k % nb_generic] = false;
+			}
+		}
+	}
+
+	// The products skipped by the cancellation are still to compute
+	uint nb_new = 0;
+	for(const auto &k: missing) {
+		if(product_done[k])
+			nb_new++;
+		else
+			table.computed[k / nb_generic][k % nb_generic] = false;
+	}
+	table.nb_computed += nb_new;
+
+	const auto stop = std::chrono::high_resolution_clock::now();
+	const auto duration = std::chrono::duration_cast<std::chrono::seconds>(stop - start);
+	std::cout << "S5-L5-S6 done in " + std::to_string(duration.count()) + "secs (" + std::to_string(nb_new) + " new products, "
+	             + std::to_string(table.nb_computed) + " in total";
+	if(nb_output < cols.size())
+		std::cout << ", " + std::to_string(cols.size() - nb_output) + " columns cancelled";
+	std::cout << ").\n";
+	return nb_output;
+}
+
+
+/*
+ * Computes the coefficient of the target monomial in a single coordinate c_{0,x} after S6.
+ *
+ * - col is the index of the coordinate in which we are looking for. (0 <= col <= 63)
+ * The other parameters are those of the function above.
+ */
+template<typename R, typename S, typename product_t, typename l4_poly_t>
+typename R::coeff coefficient_recovery(const uint &col, const std::array<l4_poly_t, 320> &l4, const uint64_t &target,
+                                       product_table<product_t> &table) {
+	typename R::coeff final_coeff = R::zero();
+	coefficient_recovery<R, S, product_t>(std::vector<uint>{col}, l4, target, table, [&final_coeff](const uint &, const typename R::coeff &coeff) {
+		final_coeff = coeff;
+		return true;
+	});
+	return final_coeff;
+}
+
+
+/*
+ * Same as above, with products of size 2 only computed for this column.
+ */
+template<typename R, typename S, typename product_t, typename l4_poly_t>
+typename R::coeff coefficient_recovery(const uint &col, const std::array<l4_poly_t, 320> &l4, const uint64_t &target) {
+	product_table<product_t> table = init_product_table<product_t>({col});
+	return coefficient_recovery<R, S, product_t>(col, l4, target, table);
+}
+
+
+/*
+ * Computes the 64 coefficients of the target monomial present on row 0 after S6.
+ * on_coefficient(i, coefficient) is called on the coefficient of column i, for
+ * each column in increasing order.
+ *
+ * - target is the monomial we are targeting.
+ * - l4 is the state after l4, initialized with only the necessary variables.
+ *  It is expected that l4 has been initialized through get_l4 first.
+ * The products of size 2 after S5 are stored as product_t (see coefficient_recovery).
+ *
+ * The output columns are processed by windows of consecutive columns: the
+ * products read by a window are computed together, in parallel, and only kept
+ * until the last column of the window which reads them. Those also read by
+ * the next window are passed on to it, the other ones are released.
+ * Each window is the largest one whose products fit in budget bytes, a product
+ * taking the average size of those computed so far, the first window being a
+ * single column. Without budget, the 384 products are computed once for all the
+ * columns, instead of 22 for each column.
+ */
+template<typename R, typename S, typename product_t, typename l4_poly_t>
+void coefficient_recovery_all_polys(const std::array<l4_poly_t, 320> &l4, const uint64_t &target,
+                                    const std::function<void(const uint &, const typename R::coeff &)> &on_coefficient,
+                                    const size_t &budget = SIZE_MAX) {
+	std::set<uint> all_cols;
+	for(uint i = 0; i < 64; i++)
+		all_cols.insert(i);
+	product_table<product_t> table = init_product_table<product_t>(all_cols);
+
+	for(uint first = 0; first < 64; ) {
+		std::set<uint> cols = {first};
+		if(budget == SIZE_MAX)
+			cols = all_cols;
+		else if(table.nb_computed) {
+			const size_t average_bytes = std::max<size_t>(table.total_bytes / table.nb_computed, 1);
+			while(first + cols.size() < 64) {
+				std::set<uint> larger = cols;
+				larger.insert(first + cols.size());
+				if(products_of_columns(larger).size() * average_bytes > budget)
+					break;
+				cols = larger;
+			}
+		}
+
+		// Products of the previous windows which are not read by this one
+		const std::set<std::pair<uint, uint>> window_products = products_of_columns(cols);
+		uint nb_kept = 0;
+		for(uint j = 0; j < 64; j++) {
+			for(uint i = 0; i < list_generic_products.size(); i++) {
+				if(!table.computed[j][i] || !table.pending[j][i])
+					continue;
+				if(window_products.count({j, i}))
+					nb_kept++;
+				else {
+					release_product(table, j, i);
+					table.computed[j][i] = false;
+				}
+			}
+		}
+
+		const auto start_s5 = std::chrono::high_resolution_clock::now();
+		std::cout << "S5/L5 for columns " + std::to_string(first) + " to " + std::to_string(first + cols.size() - 1) + ", "
+		             + std::to_string(window_products.size()) + " products (" + std::to_string(nb_kept) + " from the previous window)..." << std::endl;
+		compute_products<R, S>(cols, l4, target, table);
+		const auto stop_s5 = std::chrono::high_resolution_clock::now();
+		const auto duration_s5 = std::chrono::duration_cast<std::chrono::seconds>(stop_s5 - start_s5);
+		std::cout << "S5-L5 done in " + std::to_string(duration_s5.count()) + "secs.\n";
+
+		for(const auto &i: cols) {
+			const auto start_col = std::chrono::high_resolution_clock::now();
+			const typename R::coeff final_coeff = coefficient_recovery<R, S, product_t>(i, l4, target, table);
+			const auto stop_col = std::chrono::high_resolution_clock::now();
+			const auto duration_col = std::chrono::duration_cast<std::chrono::seconds>(stop_col - start_col);
+			std::cout << "Poly " + std::to_string(i) + " in " + std::to_string(duration_col.count()) + "secs" << std::endl;
+			on_coefficient(i, final_coeff);
+		}
+		first += cols.size();
+	}
+	std::cout << "Products of size 2 computed: " + std::to_string(table.nb_computed) + " (" + std::to_string(64 * list_products.size() - table.nb_computed)
+	             + " recomputations avoided out of " + std::to_string(64 * list_products.size()) + ")\n";
+}
+
+#endif /* ANF_ROUNDS_5_6_HPP */
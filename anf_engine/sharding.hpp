@@ -0,0 +1,378 @@
+/*
+ * Practical cube-attack against nonce-misused ASCON
+ * Filename : sharding.hpp
+ * Content : Computation of the first 4 rounds split between several local
+ *           worker processes.
+ *
+ * The workers own the columns j such that j % nb_workers is their index. The
+ * S-box only mixes coordinates of the same column, so each S-box layer is
+ * computed by the owner of the column. Each coordinate after a linear layer is
+ * the sum of three coordinates of the same row in rotated columns: before a
+ * linear layer, every worker writes the coordinates needed by the others to a
+ * file in /dev/shm, then waits for all the workers to do so, and reads the
+ * coordinates it needs from their files.
+ * The synchronization goes through a pair of pipes between the calling process
+ * and each worker.
+ *
+ * The workers are new runs of the program (fork and exec), and not plain forks
+ * of the calling process: with libgomp, a process forked once OpenMP threads
+ * are running hangs in its first parallel region. A program using workers must
+ * thus call shard_worker_main<S>() first thing in its main function: in a
+ * worker, it runs the job given by the calling process and never returns.
+*/
+
+#ifndef SHARDING_HPP
+#define SHARDING_HPP
+
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <csignal>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "rounds_1_to_4.hpp"
+
+// Environment variable holding the job of a worker (see shard_worker_main)
+inline constexpr const char *shard_worker_variable = "ASCON_SHARD_WORKER";
+
+
+// Folder of the exchanged files: shared memory when available
+inline const std::string exchange_dir() {
+	return std::filesystem::is_directory("/dev/shm") ? "/dev/shm" : std::filesystem::temp_directory_path().string();
+}
+
+
+// File in which worker w of the computation started by process id writes its
+// coordinates after layer "layer"
+inline const std::string exchange_path(const pid_t &id, const uint &w, const uint &layer) {
+	return exchange_dir() + "/ascon_shard_" + std::to_string(id) + "_" + std::to_string(w) + "_" + std::to_string(layer);
+}
+
+
+// File in which the computation started by process id writes the initial state
+inline const std::string start_path(const pid_t &id) {
+	return exchange_dir() + "/ascon_shard_" + std::to_string(id) + "_start";
+}
+
+
+// Coordinates of the columns owned by worker w
+inline const coor_mask owned_columns(const uint &w, const uint &nb_workers) {
+	coor_mask owned;
+	for(uint j = w; j < 64; j += nb_workers) {
+		for(uint i = 0; i < 5; i++)
+			owned.set(i * 64 + j);
+	}
+	return owned;
+}
+
+
+/*
+ * Writes the coordinates of s in mask to path: the 321 offsets of the
+ * coordinates in the file, then the coordinates compressed by pack_coor.
+ * The file is written under a temporary name and renamed once complete.
+ */
+inline bool write_shard(const std::string &path, const state &s, const coor_mask &mask) {
+	std::array<packed_coor, 320> packed;
+#pragma omp parallel for default(none) shared(s, mask, packed) schedule(dynamic, 1)
+	for(uint i = 0; i < 320; i++) {
+		if(mask[i])
+			packed[i] = pack_coor(s[i]);
+	}
+	std::array<uint64_t, 321> offsets = {};
+	for(uint i = 0; i < 320; i++)
+		offsets[i + 1] = offsets[i] + packed[i].size();
+
+	std::ofstream f(path + ".tmp", std::ios::binary);
+	f.write((const char *) offsets.data(), sizeof(offsets));
+	for(const auto &p: packed)
+		f.write((const char *) p.data(), p.size());
+	f.close();
+	return !f.fail() && rename((path + ".tmp").c_str(), path.c_str()) == 0;
+}
+
+
+/*
+ * Reads the coordinates in mask from a file written by write_shard into s.
+ */
+inline bool read_shard(const std::string &path, const coor_mask &mask, state &s) {
+	const int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0)
+		return false;
+	struct stat st;
+	const size_t size = (fstat(fd, &st) < 0) ? 0 : st.st_size;
+	void *addr = (size < 321 * sizeof(uint64_t)) ? MAP_FAILED : mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(addr == MAP_FAILED)
+		return false;
+
+	const uint64_t *offsets = (const uint64_t *) addr;
+	const uint8_t *body = ((const uint8_t *) addr) + 321 * sizeof(uint64_t);
+	const bool complete = (size >= 321 * sizeof(uint64_t) + offsets[320]);
+	if(complete) {
+#pragma omp parallel for default(none) shared(mask, s, offsets, body) schedule(dynamic, 1)
+		for(uint i = 0; i < 320; i++) {
+			if(mask[i] && offsets[i + 1] > offsets[i]) {
+				const uint8_t *it = body + offsets[i];
+				s[i] = unpack_coor(it);
+			}
+		}
+	}
+	munmap(addr, size);
+	return complete;
+}
+
+
+/*
+ * Worker side of a barrier: tells the calling process that this worker reached
+ * the barrier, and waits until all the workers did. Stops the worker if the
+ * calling process is gone.
+ */
+inline void worker_barrier(const int &up, const int &down) {
+	char c = 0;
+	if(write(up, &c, 1) != 1 || read(down, &c, 1) != 1)
+		_exit(EXIT_FAILURE);
+}
+
+
+/*
+ * Calling process side of a barrier: waits for all the workers, then releases
+ * them. Returns false if a worker stopped before reaching the barrier.
+ */
+inline bool parent_barrier(const std::vector<int> &ups, const std::vector<int> &downs) {
+	char c = 0;
+	for(const auto &fd: ups) {
+		if(read(fd, &c, 1) != 1)
+			return false;
+	}
+	for(const auto &fd: downs) {
+		if(write(fd, &c, 1) != 1)
+			return false;
+	}
+	return true;
+}
+
+
+/*
+ * Body of worker w: computes the layers 0 to last on its columns, then, if
+ * gather is set, writes its coordinates in cone[last] to the file read back by
+ * gather_layers.
+ */
+template<typename S>
+[[noreturn]] void run_worker(const state &start, const layer_masks<S> &cone, const uint &last, const bool &gather, const uint &w,
+                             const uint &nb_workers, const pid_t &id, const int &up, const int &down) {
+	omp_set_num_threads(std::max(1, omp_get_max_threads() / (int) nb_workers));
+	const coor_mask owned = owned_columns(w, nb_workers);
+
+	state cur = start;
+	for(uint layer = 0; layer <= last; layer++) {
+		if(layer % 2) {
+			// Exports the coordinates the other workers need, then imports the ones this worker needs
+			if(!write_shard(exchange_path(id, w, layer - 1), cur, lin_layer_cone(cone[layer] & ~owned) & owned))
+				_exit(EXIT_FAILURE);
+			worker_barrier(up, down);
+			const coor_mask imported = lin_layer_cone(cone[layer] & owned) & ~owned;
+			for(uint v = 0; v < nb_workers; v++) {
+				if(v != w && !read_shard(exchange_path(id, v, layer - 1), imported & owned_columns(v, nb_workers), cur))
+					_exit(EXIT_FAILURE);
+			}
+		}
+		cur = apply_layer<S>(cur, layer, cone[layer] & owned);
+	}
+
+	print_idle("worker " + std::to_string(w));
+	if(gather && !write_shard(exchange_path(id, w, cone.size()), cur, owned & cone[last]))
+		_exit(EXIT_FAILURE);
+	std::cout << std::flush;
+	_exit(EXIT_SUCCESS);
+}
+
+
+/*
+ * Entry point of the workers, to be called at the start of main. Does nothing
+ * in a process which is not a worker. In a worker, reads the job set by
+ * sharded_layers in the environment (the process id of the calling process,
+ * the worker index, the number of workers, the last layer, the gather flag,
+ * the ends of the pipes, the schedule and the backward cone) and the initial state, then runs
+ * the worker.
+ */
+template<typename S>
+void shard_worker_main() {
+	const char *job = getenv(shard_worker_variable);
+	if(job == nullptr)
+		return;
+
+	std::istringstream in(job);
+	pid_t id = 0;
+	uint w = 0, nb_workers = 0, last = 0, nb_rounds = 0, target_degree = 0;
+	bool gather = false;
+	int up = -1, down = -1;
+	in >> id >> w >> nb_workers >> last >> gather >> up >> down >> nb_rounds >> target_degree;
+	bool ok = !in.fail() && nb_rounds == S::nb_rounds && target_degree == S::target_degree;
+	layer_masks<S> cone;
+	for(auto &c: cone) {
+		std::string bits;
+		in >> bits;
+		ok = ok && bits.size() == c.size() && bits.find_first_not_of("01") == std::string::npos;
+		if(ok)
+			c = coor_mask(bits);
+	}
+	state start;
+	if(!ok || !read_shard(start_path(id), coor_mask().set(), start)) {
+		std::cerr << "Invalid job for a worker of the sharded computation" << std::endl;
+		_exit(EXIT_FAILURE);
+	}
+	run_worker<S>(start, cone, last, gather, w, nb_workers, id, up, down);
+}
+
+
+/*
+ * Computes the layers 0 to last (0 for S1, 1 for L1, ..., 7 for L4 with 4 rounds) of the
+ * state from start with nb_workers processes, each one holding only its own
+ * columns. Only the coordinates in the backward cone "cone" are computed.
+ * If gather is set, each worker writes the coordinates it computed in
+ * cone[last] to a file, left for gather_layers to read and remove. Otherwise,
+ * no file is left behind.
+ * Stops the program if a worker fails.
+ */
+template<typename S>
+void sharded_layers(const state &start, const layer_masks<S> &cone, const uint &last, const uint &nb_workers, const bool &gather = false) {
+	if(getenv(shard_worker_variable) != nullptr) {
+		std::cerr << "A worker of the sharded computation ran the program: shard_worker_main is not called at the start of main" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	const pid_t id = getpid();
+	std::vector<int> ups;
+	std::vector<int> downs;
+	std::vector<pid_t> workers;
+	void (*previous_handler)(int) = signal(SIGPIPE, SIG_IGN); // A failed worker is detected by the barriers
+	std::cout << std::flush;
+
+	// Environment of the workers: the one of this process, and their job
+	std::vector<std::string> environment;
+	for(char **e = environ; *e != nullptr; e++) {
+		if(std::string(*e).rfind(std::string(shard_worker_variable) + "=", 0) != 0)
+			environment.push_back(*e);
+	}
+	std::string cone_bits;
+	for(const auto &c: cone)
+		cone_bits.append(" ").append(c.to_string());
+
+	bool ok = write_shard(start_path(id), start, coor_mask().set());
+	for(uint w = 0; w < nb_workers && ok; w++) {
+		int up[2];
+		int down[2];
+		if(pipe(up) || pipe(down)) {
+			ok = false;
+			break;
+		}
+
+		// Everything is allocated before the fork: the worker only closes
+		// file descriptors before running the program again.
+		std::vector<std::string> worker_environment = environment;
+		worker_environment.push_back(std::string(shard_worker_variable) + "=" + std::to_string(id) + " " + std::to_string(w) + " "
+		                             + std::to_string(nb_workers) + " " + std::to_string(last) + " " + std::to_string(gather) + " " + std::to_string(up[1]) + " "
+		                             + std::to_string(down[0]) + " " + std::to_string(S::nb_rounds) + " "
+		                             + std::to_string(S::target_degree) + cone_bits);
+		std::vector<char *> envp;
+		for(auto &e: worker_environment)
+			envp.push_back(e.data());
+		envp.push_back(nullptr);
+		char worker_name[] = "ascon_shard_worker";
+		char *argv[] = {worker_name, nullptr};
+
+		const pid_t pid = fork();
+		if(pid == 0) {
+			// The ends kept by the calling process must not stay open in the worker
+			for(const auto &fd: ups)
+				close(fd);
+			for(const auto &fd: downs)
+				close(fd);
+			close(up[0]);
+			close(down[1]);
+			execve("/proc/self/exe", argv, envp.data());
+			_exit(EXIT_FAILURE);
+		}
+		close(up[1]);
+		close(down[0]);
+		if(pid < 0) {
+			close(up[0]);
+			close(down[1]);
+			ok = false;
+			break;
+		}
+		ups.push_back(up[0]);
+		downs.push_back(down[1]);
+		workers.push_back(pid);
+	}
+
+	// One barrier before each linear layer. The files exchanged before a linear
+	// layer are no longer read once all the workers reach the next barrier.
+	for(uint layer = 1; layer <= last && ok; layer += 2) {
+		ok = parent_barrier(ups, downs);
+		if(layer >= 3) {
+			for(uint w = 0; w < nb_workers; w++)
+				remove(exchange_path(id, w, layer - 3).c_str());
+		}
+	}
+
+	for(const auto &fd: ups)
+		close(fd);
+	for(const auto &fd: downs)
+		close(fd);
+	for(const auto &pid: workers) {
+		if(!ok)
+			kill(pid, SIGKILL);
+		int status = 0;
+		waitpid(pid, &status, 0);
+		ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+	}
+	for(uint layer = 0; layer <= last; layer += 2) {
+		for(uint w = 0; w < nb_workers; w++) {
+			remove(exchange_path(id, w, layer).c_str());
+			remove((exchange_path(id, w, layer) + ".tmp").c_str());
+		}
+	}
+	remove(start_path(id).c_str());
+	remove((start_path(id) + ".tmp").c_str());
+	signal(SIGPIPE, previous_handler);
+
+	if(!ok) {
+		for(uint w = 0; w < nb_workers; w++) {
+			remove(exchange_path(id, w, cone.size()).c_str());
+			remove((exchange_path(id, w, cone.size()) + ".tmp").c_str());
+		}
+		std::cerr << "A worker of the sharded computation failed" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+}
+
+
+/*
+ * Same as sharded_layers, but the coordinates in cone[last] are sent back to
+ * the calling process, which returns them as a single state.
+ */
+template<typename S>
+state gather_layers(const state &start, const layer_masks<S> &cone, const uint &last, const uint &nb_workers) {
+	const pid_t id = getpid();
+	const uint gathered_layer = cone.size(); // Files of the gathered coordinates, distinct from the exchanged ones
+	sharded_layers<S>(start, cone, last, nb_workers, true);
+
+	state gathered;
+	bool ok = true;
+	for(uint w = 0; w < nb_workers; w++) {
+		const std::string path = exchange_path(id, w, gathered_layer);
+		ok = ok && read_shard(path, owned_columns(w, nb_workers) & cone[last], gathered);
+		remove(path.c_str());
+	}
+	if(!ok) {
+		std::cerr << "The sharded computation could not be gathered" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	return gathered;
+}
+
+#endif /* SHARDING_HPP */
@@ -0,0 +1,295 @@
+/*
+ * Practical cube-attack against nonce-misused ASCON
+ * Filename : spill.hpp
+ * Content : Storage of the polynomials in v_i under a memory budget. The
+ *           polynomials which do not fit in the budget are written as sorted
+ *           arrays of terms to files on local disk and memory-mapped, so that
+ *           the OS pages them in and out as needed.
+*/
+
+#ifndef SPILL_HPP
+#define SPILL_HPP
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <type_traits>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "dense_layer.hpp"
+
+/*
+ * Memory budget shared by all the stored polynomials.
+ * - limit is the number of bytes the polynomials kept in memory may use.
+ * - dir is the folder in which the other polynomials are spilled.
+ */
+struct storage_budget {
+	size_t limit = SIZE_MAX;
+	std::string dir = ".";
+	std::atomic<size_t> in_memory = 0;
+	std::atomic<size_t> on_disk = 0;
+};
+
+inline storage_budget &memory_budget() {
+	static storage_budget budget;
+	return budget;
+}
+
+
+/*
+ * Sets the number of bytes the stored polynomials may use in memory, and the
+ * folder (preferably on a local disk) in which the others are spilled.
+ */
+inline void set_memory_budget(const size_t &limit, const std::string &dir) {
+	memory_budget().limit = limit;
+	memory_budget().dir = dir;
+}
+
+
+inline void print_storage() {
+	std::cout << "Stored polynomials: " + std::to_string(memory_budget().in_memory >> 20) + "MB in memory, " + std::to_string(memory_budget().on_disk >> 20) + "MB spilled to disk\n";
+}
+
+
+using mapped_file = std::shared_ptr<const void>;
+
+/*
+ * Writes size bytes to a new file of the spill folder and maps it read-only.
+ * The file is unlinked right away: it disappears once unmapped, even if the
+ * program is interrupted.
+ */
+inline mapped_file map_to_file(const void *data, const size_t &size) {
+	std::string path = memory_budget().dir + "/spill_XXXXXX";
+	const int fd = mkstemp(path.data());
+	if(fd < 0) {
+		perror(("Cannot create a spill file in " + memory_budget().dir).c_str());
+		exit(EXIT_FAILURE);
+	}
+	unlink(path.c_str());
+
+	const char *p = (const char *) data;
+	size_t written = 0;
+	while(written < size) {
+		const ssize_t w = write(fd, p + written, size - written);
+		if(w < 0) {
+			perror("Cannot write a spill file");
+			exit(EXIT_FAILURE);
+		}
+		written += w;
+	}
+
+	void *addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(addr == MAP_FAILED) {
+		perror("Cannot map a spill file");
+		exit(EXIT_FAILURE);
+	}
+	return mapped_file(addr, [size](const void *a) {munmap((void *) a, size);});
+}
+
+
+/*
+ * Maps the whole file path read-only and stores its size in size. The pages
+ * are shared with every other process mapping the same file.
+ * Returns an empty pointer if the file cannot be mapped.
+ */
+inline mapped_file map_file(const std::string &path, size_t &size) {
+	const int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0)
+		return nullptr;
+	struct stat st;
+	if(fstat(fd, &st) < 0 || st.st_size == 0) {
+		close(fd);
+		return nullptr;
+	}
+	size = st.st_size;
+	void *addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(addr == MAP_FAILED)
+		return nullptr;
+	const size_t mapped_size = size;
+	return mapped_file(addr, [mapped_size](const void *a) {munmap((void *) a, mapped_size);});
+}
+
+
+/*
+ * Polynomial in v_i kept in memory (see layered_poly) as long as the budget
+ * allows it, and spilled to a memory-mapped file otherwise.
+ * A spilled polynomial is an array of terms sorted by monomial: for_each reads
+ * the file sequentially and find is a binary search. The same representation
+ * is used for views on the terms of a file mapped by someone else (see
+ * l4_cache.hpp), which are neither counted in the budget nor owned.
+ * Coefficients which cannot be written as raw bytes (e.g. sets of monomials)
+ * are always kept in memory. The Bloom filter of a spilled polynomial stays in
+ * memory, views have none.
+ */
+template<typename coeff_t>
+class stored_poly {
+public:
+	static constexpr bool spillable = std::is_trivially_copyable_v<coeff_t>;
+
+	using term = poly_term<coeff_t>;
+
+	stored_poly() = default;
+
+	// The budget is checked before the layers are built, so that a spilled polynomial never takes them in memory
+	stored_poly(std::map<uint64_t, coeff_t> &&m, const uint64_t &vars) {
+		const size_t needed = layered_poly<coeff_t>::bytes_for(m, vars);
+		if constexpr(spillable) {
+			if(memory_budget().in_memory.fetch_add(needed) + needed > memory_budget().limit && !m.empty()) {
+				memory_budget().in_memory -= needed;
+				spill(m);
+				return;
+			}
+		}
+		else
+			memory_budget().in_memory += needed;
+		memory = layered_poly<coeff_t>(std::move(m), vars);
+		nb_bytes = needed;
+	}
+
+	// View on nb_terms sorted terms inside file, which stays mapped as long as a view on it exists
+	stored_poly(const mapped_file &file, const term *terms, const size_t &nb_terms) :
+		file(file), terms(terms), nb_terms(nb_terms) {}
+
+	stored_poly(const stored_poly &) = delete;
+	stored_poly &operator=(const stored_poly &) = delete;
+
+	stored_poly(stored_poly &&other) noexcept {
+		*this = std::move(other);
+	}
+
+	stored_poly &operator=(stored_poly &&other) noexcept {
+		if(this != &other) {
+			release();
+			memory = std::move(other.memory);
+			file = std::move(other.file);
+			filter = std::move(other.filter);
+			terms = other.terms;
+			nb_terms = other.nb_terms;
+			nb_bytes = other.nb_bytes;
+			nb_disk_bytes = other.nb_disk_bytes;
+			spilled = other.spilled;
+			other.terms = nullptr;
+			other.nb_terms = 0;
+			other.nb_bytes = 0;
+			other.nb_disk_bytes = 0;
+			other.spilled = false;
+		}
+		return *this;
+	}
+
+	~stored_poly() {
+		release();
+	}
+
+	const coeff_t *find(const uint64_t &m) const {
+		if(!terms)
+			return memory.find(m);
+		const term *it = std::lower_bound(terms, terms + nb_terms, m, [](const term &t, const uint64_t &x) {return t.monom < x;});
+		return (it != terms + nb_terms && it->monom == m) ? &(it->coeff) : nullptr;
+	}
+
+	template<typename F>
+	void for_each(F f) const {
+		if(!terms)
+			memory.for_each(f);
+		else {
+			for(size_t i = 0; i < nb_terms; i++)
+				f(terms[i].monom, terms[i].coeff);
+		}
+	}
+
+	// False only if m does not appear
+	bool might_contain(const uint64_t &m) const {
+		if(!terms)
+			return memory.might_contain(m);
+		return filter.might_contain(m);
+	}
+
+	// Terms sorted by monomial, or an empty span if the polynomial is dense
+	std::span<const term> sorted_terms() const {
+		if(!terms)
+			return memory.sorted_terms();
+		return std::span<const term>(terms, nb_terms);
+	}
+
+	size_t size() const {
+		return terms ? nb_terms : memory.size();
+	}
+
+	bool empty() const {
+		return size() == 0;
+	}
+
+	bool is_dense() const {
+		return !terms && memory.is_dense();
+	}
+
+	bool is_spilled() const {
+		return spilled;
+	}
+
+	// Bytes taken in memory: only the Bloom filter once spilled, 0 for a view
+	size_t bytes() const {
+		return nb_bytes;
+	}
+
+	// Bytes of the spill file, 0 if the polynomial is in memory or a view
+	size_t disk_bytes() const {
+		return nb_disk_bytes;
+	}
+
+private:
+	layered_poly<coeff_t> memory;
+	bloom_filter filter; // Filter of a spilled polynomial
+	mapped_file file;
+	const term *terms = nullptr; // Terms in file, for a spilled polynomial or a view
+	size_t nb_terms = 0;
+	size_t nb_bytes = 0; // Bytes accounted in the in-memory budget
+	size_t nb_disk_bytes = 0; // Bytes of the spill file
+	bool spilled = false;
+
+	// Writes the terms of m, already in increasing order of monomials, to a spill file
+	void spill(const std::map<uint64_t, coeff_t> &m) {
+		std::vector<term> sorted;
+		sorted.reserve(m.size());
+		filter = bloom_filter(m.size());
+		for(const auto &[monom, coeff]: m) {
+			sorted.push_back({monom, coeff});
+			filter.insert(monom);
+		}
+		nb_bytes = filter.bytes();
+		memory_budget().in_memory += nb_bytes;
+
+		nb_terms = sorted.size();
+		nb_disk_bytes = nb_terms * sizeof(term);
+		file = map_to_file(sorted.data(), nb_disk_bytes);
+		terms = (const term *) file.get();
+		spilled = true;
+		memory_budget().on_disk += nb_disk_bytes;
+	}
+
+	void release() {
+		memory_budget().in_memory -= nb_bytes;
+		memory_budget().on_disk -= nb_disk_bytes;
+		memory = layered_poly<coeff_t>();
+		filter = bloom_filter();
+		file.reset();
+		terms = nullptr;
+		nb_terms = 0;
+		nb_bytes = 0;
+		nb_disk_bytes = 0;
+		spilled = false;
+	}
+};
+
+#endif /* SPILL_HPP */
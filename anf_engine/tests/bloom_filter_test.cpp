@@ -0,0 +1,63 @@
+/*
+ * Practical cube-attack against nonce-misused ASCON
+ * Filename : bloom_filter_test.cpp
+ * Content : Checks that a Bloom filter keeps every inserted monomial, lets
+ *           few absent ones pass, and takes the size given by bytes_for.
+*/
+
+#include <random>
+#include <set>
+#include <string>
+#include <iostream>
+#include "../bloom_filter.hpp"
+
+using namespace std;
+
+static uint nb_failures = 0;
+
+static void check(const bool &condition, const string &what) {
+	if(!condition) {
+		cerr << "FAILED: " << what << endl;
+		nb_failures++;
+	}
+}
+
+
+int main() {
+	mt19937_64 gen(2022);
+
+	// An empty filter lets every monomial pass
+	check(bloom_filter().might_contain(gen()), "empty filter");
+
+	for(const size_t n: {0, 1, 100, 10000, 100000}) {
+		set<uint64_t> inserted;
+		while(inserted.size() < n)
+			inserted.insert(gen() & gen());
+		bloom_filter filter(n);
+		for(const auto &m: inserted)
+			filter.insert(m);
+		check(filter.bytes() == bloom_filter::bytes_for(n), "size of a filter for " + to_string(n) + " monomials");
+
+		size_t missed = 0;
+		for(const auto &m: inserted)
+			missed += !filter.might_contain(m);
+		check(missed == 0, to_string(missed) + " inserted monomials ruled out among " + to_string(n));
+
+		// Less than 2% of false positives are expected, 3% are allowed
+		size_t absent = 0;
+		size_t passed = 0;
+		for(uint i = 0; i < 100000; i++) {
+			const uint64_t m = gen() & gen();
+			if(!inserted.count(m)) {
+				absent++;
+				passed += filter.might_contain(m);
+			}
+		}
+		check(100 * passed <= 3 * absent, to_string(passed) + " false positives among " + to_string(absent) + " with " + to_string(n) + " monomials");
+	}
+
+	if(nb_failures)
+		return EXIT_FAILURE;
+	cout << "bloom_filter_test: OK" << endl;
+	return EXIT_SUCCESS;
+}
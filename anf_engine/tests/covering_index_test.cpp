@@ -0,0 +1,119 @@
+/*
+ * Practical cube-attack against nonce-misused ASCON
+ * Filename : covering_index_test.cpp
+ * Content : Checks that a covering index finds, for each query, exactly the
+ *           monomials of the degrees it indexes which have one variable more
+ *           than the query, against an exhaustive search.
+*/
+
+#include <random>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "../covering_index.hpp"
+#include "../dense_layer.hpp"
+
+using namespace std;
+
+static uint nb_failures = 0;
+
+static void check(const bool &condition, const string &what) {
+	if(!condition) {
+		cerr << "FAILED: " << what << endl;
+		nb_failures++;
+	}
+}
+
+
+// Polynomial with its terms in a map, enough for covering_index
+struct map_poly {
+	map<uint64_t, uint> terms;
+
+	template<typename F>
+	void for_each(F f) const {
+		for(const auto &[monom, coeff]: terms)
+			f(monom, coeff);
+	}
+};
+
+
+// Random monomial of degree d in the variables of vars
+static uint64_t random_monom(mt19937_64 &gen, const uint64_t &vars, const uint &d) {
+	uint64_t m = 0;
+	while((uint) __builtin_popcountll(m) < d)
+		m |= deposit_monom(((uint64_t) 1) << (gen() % __builtin_popcountll(vars)), vars);
+	return m;
+}
+
+
+int main() {
+	mt19937_64 gen(2022);
+
+	for(const uint nb_vars: {12, 31}) {
+		// Random variables, bit 62 excepted
+		uint64_t vars = 0;
+		while((uint) __builtin_popcountll(vars) < nb_vars)
+			vars |= (((uint64_t) 1) << (gen() % 64)) & ~(((uint64_t) 1) << 62);
+		const uint min_degree = nb_vars / 2;
+		const uint max_degree = nb_vars / 2 + 1;
+
+		// Terms of degree min_degree - 1 to max_degree + 1, some out of vars: only the
+		// ones of degree min_degree to max_degree in vars are indexed
+		map_poly p;
+		for(uint i = 0; i < 2000; i++) {
+			uint64_t m = random_monom(gen, vars, min_degree - 1 + gen() % 4);
+			if(!(gen() % 10))
+				m |= ((uint64_t) 1) << 62;
+			p.terms[m] = i;
+		}
+		const covering_index index(p, vars, min_degree, max_degree);
+		check(!index.empty(), "index on " + to_string(nb_vars) + " variables");
+
+		// Queries of the degrees just below the indexed ones, half of them covered
+		vector<pair<uint64_t, uint>> queries;
+		for(uint i = 0; i < 1000; i++) {
+			uint64_t q = random_monom(gen, vars, min_degree - 1 + gen() % 2);
+			if(i % 2) {
+				auto it = p.terms.begin();
+				advance(it, gen() % p.terms.size());
+				const uint64_t m = it->first & vars;
+				if(m)
+					q = m ^ (m & (~m + 1));
+			}
+			queries.emplace_back(q, i);
+		}
+		sort(queries.begin(), queries.end(), [&vars](const pair<uint64_t, uint> &q1, const pair<uint64_t, uint> &q2) {
+			return compress_monom(q1.first, vars) < compress_monom(q2.first, vars);
+		});
+
+		map<uint, set<uint64_t>> found;
+		index.for_each_cover(queries.data(), queries.data() + queries.size(), [&found](const pair<uint64_t, uint> &q, const uint64_t &m) {
+			found[q.second].insert(m);
+		});
+
+		size_t nb_covers = 0;
+		for(const auto &[q, i]: queries) {
+			set<uint64_t> expected;
+			for(const auto &[m, coeff]: p.terms) {
+				const uint d = __builtin_popcountll(m);
+				if(d >= min_degree && d <= max_degree && !(m & ~vars) && (m & q) == q && __builtin_popcountll(m ^ q) == 1)
+					expected.insert(m);
+			}
+			nb_covers += expected.size();
+			check(found[i] == expected, "covers of query " + to_string(i) + " on " + to_string(nb_vars) + " variables");
+		}
+		check(nb_covers > 0, "some queries covered on " + to_string(nb_vars) + " variables");
+	}
+
+	// More than 32 variables are not indexed
+	map_poly p;
+	p.terms[~((uint64_t) 0)] = 1;
+	check(covering_index(p, ~((uint64_t) 0), 0, 64).empty(), "no index on 64 variables");
+
+	if(nb_failures)
+		return EXIT_FAILURE;
+	cout << "covering_index_test: OK" << endl;
+	return EXIT_SUCCESS;
+}
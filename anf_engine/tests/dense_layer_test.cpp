@@ -0,0 +1,131 @@
+/*
+ * Practical cube-attack against nonce-misused ASCON
+ * Filename : dense_layer_test.cpp
+ * Content : Checks that the dense layers rank and unrank the monomials
+ *           consistently (lookups, and terms visited in rank order), and that
+ *           layered_poly finds the same terms dense or sparse, in the size
+ *           announced by bytes_for.
+*/
+
+#include <random>
+#include <map>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "../dense_layer.hpp"
+
+using namespace std;
+
+static uint nb_failures = 0;
+
+static void check(const bool &condition, const string &what) {
+	if(!condition) {
+		cerr << "FAILED: " << what << endl;
+		nb_failures++;
+	}
+}
+
+
+// Random monomial of degree d in the variables of vars
+static uint64_t random_monom(mt19937_64 &gen, const uint64_t &vars, const uint &d) {
+	uint64_t m = 0;
+	while((uint) __builtin_popcountll(m) < d)
+		m |= deposit_monom(((uint64_t) 1) << (gen() % __builtin_popcountll(vars)), vars);
+	return m;
+}
+
+
+// Checks p against the terms of m: lookups of present and absent monomials, and terms visited
+template<typename poly_t>
+static void check_terms(const poly_t &p, const map<uint64_t, uint64_t> &m, const uint64_t &vars, mt19937_64 &gen, const string &what) {
+	check(p.size() == m.size(), what + ": number of terms");
+	for(const auto &[monom, coeff]: m) {
+		const uint64_t *found = p.find(monom);
+		if(found == nullptr || *found != coeff) {
+			check(false, what + ": lookup of a present monomial");
+			break;
+		}
+	}
+	for(uint i = 0; i < 1000; i++) {
+		const uint64_t monom = random_monom(gen, vars, gen() % (__builtin_popcountll(vars) + 1));
+		if(!m.count(monom) && p.find(monom) != nullptr) {
+			check(false, what + ": lookup of an absent monomial");
+			break;
+		}
+	}
+
+	map<uint64_t, uint64_t> visited;
+	p.for_each([&visited](const uint64_t &monom, const uint64_t &coeff) {visited[monom] = coeff;});
+	check(visited == m, what + ": terms visited");
+}
+
+
+int main() {
+	mt19937_64 gen(2022);
+
+	// Ranks: each layer on its own, either full (all ranks are consecutive) or with random gaps
+	for(const uint nb_vars: {1, 5, 16, 24}) {
+		uint64_t vars = 0;
+		while((uint) __builtin_popcountll(vars) < nb_vars)
+			vars |= ((uint64_t) 1) << (gen() % 64);
+		for(uint degree = 0; degree <= nb_vars; degree++) {
+			const uint64_t nb_monoms = binomial[nb_vars][degree];
+			for(const bool full: {true, false}) {
+				if(full && nb_monoms > 100000)
+					continue;
+				map<uint64_t, uint64_t> m;
+				if(full) {
+					uint64_t c = (((uint64_t) 1) << degree) - 1;
+					for(uint64_t r = 0; r < nb_monoms; r++) {
+						m[deposit_monom(c, vars)] = gen();
+						if(degree)
+							c = next_combination(c);
+					}
+				}
+				else {
+					for(uint i = 0; i < 2000; i++)
+						m[random_monom(gen, vars, degree)] = gen();
+				}
+				const string what = to_string(degree) + " of " + to_string(nb_vars) + " variables" + (full ? ", full" : "");
+
+				map<uint64_t, uint64_t> copy = m;
+				const dense_layer<uint64_t> layer(copy, vars, degree);
+				check_terms(layer, m, vars, gen, "layer of degree " + what);
+
+				// Rank order is the order of the compressed monomials
+				uint64_t previous = 0;
+				bool first = true;
+				bool sorted = true;
+				layer.for_each([&](const uint64_t &monom, const uint64_t &) {
+					const uint64_t c = compress_monom(monom, vars);
+					sorted = sorted && (first || previous < c);
+					previous = c;
+					first = false;
+				});
+				check(sorted, "rank order of the layer of degree " + what);
+			}
+		}
+	}
+
+	// Polynomials of several degrees, dense or sparse depending on the number of terms
+	for(const size_t nb_terms: {0, 10, 1000, 40000}) {
+		uint64_t vars = 0;
+		while(__builtin_popcountll(vars) < 20)
+			vars |= ((uint64_t) 1) << (gen() % 64);
+		map<uint64_t, uint64_t> m;
+		while(m.size() < nb_terms)
+			m[random_monom(gen, vars, 9 + gen() % 3)] = gen();
+		const size_t expected_bytes = layered_poly<uint64_t>::bytes_for(m, vars);
+		map<uint64_t, uint64_t> copy = m;
+		const layered_poly<uint64_t> p(std::move(copy), vars);
+		const string what = "polynomial of " + to_string(nb_terms) + " terms" + (p.is_dense() ? " (dense)" : " (sparse)");
+		check_terms(p, m, vars, gen, what);
+		check(p.bytes() == expected_bytes, what + ": bytes_for");
+		check(p.is_dense() == (nb_terms == 40000), what + ": representation");
+	}
+
+	if(nb_failures)
+		return EXIT_FAILURE;
+	cout << "dense_layer_test: OK" << endl;
+	return EXIT_SUCCESS;
+}
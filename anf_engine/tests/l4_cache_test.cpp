@@ -0,0 +1,131 @@
+/*
+ * Practical cube-attack against nonce-misused ASCON
+ * Filename : l4_cache_test.cpp
+ * Content : Checks the cache of the coordinates after L4 of phase 3 (see
+ *           phase_3/coefficient_recovery/l4_cache.cpp): written by a first
+ *           run, read back by the next one, and rejected then written again
+ *           when its offsets are corrupted or the file is truncated.
+*/
+
+#include <random>
+#include <sstream>
+#include <filesystem>
+#include <unistd.h>
+#include "../../phase_3/coefficient_recovery/l4_cache.hpp"
+
+using namespace std;
+
+static uint nb_failures = 0;
+
+static void check(const bool &condition, const string &what) {
+	if(!condition) {
+		cerr << "FAILED: " << what << endl;
+		nb_failures++;
+	}
+}
+
+
+/*
+ * Initial state of phase 3 for a random cube of 12 columns: v_i in row 0 of
+ * the cube columns, random constants in row 1, b_i and c_i in rows 2 and 3,
+ * c_i and random constants in row 4.
+ */
+static state random_start(mt19937_64 &gen, uint64_t &target) {
+	set<uint> cube;
+	while(cube.size() < 12)
+		cube.insert(gen() % 64);
+
+	state start;
+	target = 0;
+	for(uint j = 0; j < 64; j++) {
+		if(cube.count(j)) {
+			monom v = {0, 0, 0, 0, 0};
+			v[0] = ((uint64_t) 1) << (63 - j);
+			start[j].insert(v);
+			target |= v[0];
+		}
+		if(gen() % 2)
+			start[64 + j].insert(monom{0, 0, 0, 0, 0});
+		for(uint i = 2; i < 4; i++) {
+			monom bc = {0, 0, 0, 0, 0};
+			bc[i] = ((uint64_t) 1) << (63 - j);
+			start[i * 64 + j].insert(bc);
+		}
+		monom c = {0, 0, 0, 0, 0};
+		c[3] = ((uint64_t) 1) << (63 - j);
+		start[256 + j].insert(c);
+		if(gen() % 2)
+			start[256 + j].insert(monom{0, 0, 0, 0, 0});
+	}
+	return start;
+}
+
+
+// Runs cached_l4 and returns what it printed
+static string run_cached_l4(const state &start, const uint64_t &target, const string &dir, stored_l4 &l4) {
+	stringstream out;
+	streambuf *previous = cout.rdbuf(out.rdbuf());
+	l4 = cached_l4(start, target, dir);
+	cout.rdbuf(previous);
+	return out.str();
+}
+
+
+static bool same_l4(const stored_l4 &l4, const array<poly_map, 320> &expected) {
+	for(uint i = 0; i < 320; i++) {
+		poly_map terms;
+		l4[i].for_each([&terms](const uint64_t &monom, const coefficient &coeff) {terms[monom] = coeff;});
+		if(terms != expected[i])
+			return false;
+	}
+	return true;
+}
+
+
+int main() {
+	shard_worker_main();
+	mt19937_64 gen(2022);
+	uint64_t target = 0;
+	const state start = random_start(gen, target);
+	const array<poly_map, 320> expected = get_l4(start);
+	const string dir = (filesystem::temp_directory_path() / ("l4_cache_test_" + to_string(getpid()))).string();
+	filesystem::remove_all(dir);
+
+	stored_l4 l4;
+	check(run_cached_l4(start, target, dir, l4).find("L4 written to cache") != string::npos, "cache written by the first run");
+	check(same_l4(l4, expected), "coordinates written to the cache");
+	check(run_cached_l4(start, target, dir, l4).find("L4 read from cache") != string::npos, "cache read by the second run");
+	check(same_l4(l4, expected), "coordinates read from the cache");
+	l4 = stored_l4();
+
+	string path;
+	for(const auto &entry: filesystem::directory_iterator(dir))
+		path = entry.path().string();
+
+	// Offsets of the coordinates 100 and 101 swapped: coordinate 100 ends before it starts
+	{
+		fstream f(path, ios::in | ios::out | ios::binary);
+		array<uint64_t, 2> offsets;
+		f.seekg((3 + 100) * sizeof(uint64_t));
+		f.read((char *) offsets.data(), sizeof(offsets));
+		check(offsets[0] < offsets[1], "coordinate 100 is not empty");
+		swap(offsets[0], offsets[1]);
+		f.seekp((3 + 100) * sizeof(uint64_t));
+		f.write((const char *) offsets.data(), sizeof(offsets));
+	}
+	check(run_cached_l4(start, target, dir, l4).find("L4 written to cache") != string::npos, "cache with decreasing offsets rejected");
+	check(same_l4(l4, expected), "coordinates computed again after decreasing offsets");
+	l4 = stored_l4();
+
+	// Half a term missing at the end of the file
+	filesystem::resize_file(path, filesystem::file_size(path) - sizeof(poly_term<coefficient>) / 2);
+	check(run_cached_l4(start, target, dir, l4).find("L4 written to cache") != string::npos, "truncated cache rejected");
+	check(same_l4(l4, expected), "coordinates computed again after truncation");
+	l4 = stored_l4();
+
+	filesystem::remove_all(dir);
+	if(nb_failures)
+		return EXIT_FAILURE;
+	cout << "l4_cache_test: OK" << endl;
+	return EXIT_SUCCESS;
+}
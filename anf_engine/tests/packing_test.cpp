@@ -0,0 +1,79 @@
+/*
+ * Practical cube-attack against nonce-misused ASCON
+ * Filename : packing_test.cpp
+ * Content : Checks that pack_state and unpack_state give back the packed
+ *           coordinates, empty ones included, and the memory they report as
+ *           saved.
+*/
+
+#include <random>
+#include "../anf.hpp"
+
+using namespace std;
+
+static uint nb_failures = 0;
+
+static void check(const bool &condition, const string &what) {
+	if(!condition) {
+		cerr << "FAILED: " << what << endl;
+		nb_failures++;
+	}
+}
+
+
+// Coordinate of n random monomials in the 5 words
+static coor random_coor(mt19937_64 &gen, const uint &n) {
+	coor c;
+	while(c.size() < n) {
+		monom m;
+		for(auto &w: m)
+			w = gen() & gen();
+		c.insert(m);
+	}
+	return c;
+}
+
+
+int main() {
+	mt19937_64 gen(2022);
+
+	// Row 0 holds coordinates of up to 200 monomials, row 1 is left empty
+	state s;
+	coor_mask mask;
+	for(uint j = 0; j < 64; j++) {
+		s[j] = random_coor(gen, gen() % 200);
+		mask.set(j);
+		mask.set(64 + j);
+	}
+	const state original = s;
+
+	int64_t expected = 0;
+	for(uint i = 0; i < 320; i++) {
+		if(mask[i])
+			expected += (int64_t) coor_bytes(s[i]) - (int64_t) pack_coor(s[i]).capacity();
+	}
+
+	packed_state packed;
+	const size_t saved = pack_state(s, mask, packed);
+	check(saved == (size_t) expected, "memory saved by the compression");
+	for(uint i = 0; i < 320; i++)
+		check(s[i].empty(), "coordinate " + to_string(i) + " released");
+
+	const state unpacked = unpack_state(packed, mask);
+	for(uint i = 0; i < 320; i++)
+		check(unpacked[i] == original[i], "coordinate " + to_string(i) + " unpacked");
+
+	// Only empty coordinates: the packed bytes are not a saving
+	state empty;
+	coor_mask empty_mask;
+	empty_mask.set(0);
+	empty_mask.set(1);
+	packed_state packed_empty;
+	check(pack_state(empty, empty_mask, packed_empty) == 0, "no memory saved on empty coordinates");
+	check(unpack_state(packed_empty, empty_mask)[0].empty(), "empty coordinate unpacked");
+
+	if(nb_failures)
+		return EXIT_FAILURE;
+	cout << "packing_test: OK" << endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,67 @@
+/*
+ * Practical cube-attack against nonce-misused ASCON
+ * Filename : popcount_filter_test.cpp
+ * Content : Checks that the vectorized kernels of select_sharing_at_most
+ *           supported by the processor select the same indices as the scalar
+ *           one, on random keys.
+*/
+
+#include <random>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "../popcount_filter.hpp"
+
+using namespace std;
+
+static uint nb_failures = 0;
+
+static void check(const bool &condition, const string &what) {
+	if(!condition) {
+		cerr << "FAILED: " << what << endl;
+		nb_failures++;
+	}
+}
+
+
+// Runs kernel against the scalar kernel on n random keys, for every k up to 8
+static void check_kernel(const string &name, const select_sharing_at_most_t &kernel, mt19937_64 &gen) {
+	for(size_t n = 0; n < 100; n++) {
+		vector<uint64_t> keys(n);
+		for(auto &key: keys)
+			key = gen() & gen() & gen(); // 8 bits set on average, so that every k selects some keys
+		const uint64_t m = gen() & gen();
+		for(unsigned int k = 0; k <= 8; k++) {
+			vector<uint32_t> expected(n);
+			vector<uint32_t> selected(n);
+			const size_t nb_expected = select_sharing_at_most_scalar(m, keys.data(), n, k, expected.data());
+			const size_t nb_selected = kernel(m, keys.data(), n, k, selected.data());
+			expected.resize(nb_expected);
+			selected.resize(nb_selected);
+			check(selected == expected, name + " on " + to_string(n) + " keys with k = " + to_string(k));
+		}
+	}
+	cout << "popcount_filter_test: " + name + " checked\n";
+}
+
+
+int main() {
+	mt19937_64 gen(2022);
+	check_kernel("kernel picked at runtime", select_sharing_at_most, gen);
+#if defined(__x86_64__)
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq"))
+		check_kernel("AVX-512", select_sharing_at_most_avx512, gen);
+	else
+		cout << "popcount_filter_test: AVX-512 not supported, skipped\n";
+	if(__builtin_cpu_supports("avx2"))
+		check_kernel("AVX2", select_sharing_at_most_avx2, gen);
+	else
+		cout << "popcount_filter_test: AVX2 not supported, skipped\n";
+#endif
+
+	if(nb_failures)
+		return EXIT_FAILURE;
+	cout << "popcount_filter_test: OK" << endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,251 @@
+/*
+ * Practical cube-attack against nonce-misused ASCON
+ * Filename : rounds_5_6_test.cpp
+ * Content : Checks sort_terms, merge_terms, and the products of S5 and S6
+ *           against naive nested loops, for polynomials stored dense, sparse
+ *           or spilled, with and without covering index.
+*/
+
+#include <random>
+#include "../rounds_5_6.hpp"
+#include "../spill.hpp"
+
+using namespace std;
+
+static uint nb_failures = 0;
+
+static void check(const bool &condition, const string &what) {
+	if(!condition) {
+		cerr << "FAILED: " << what << endl;
+		nb_failures++;
+	}
+}
+
+
+/*
+ * Coefficients for the tests: words added by XOR and multiplied by AND, which
+ * is commutative and distributes over the addition, as the coefficients of the
+ * attack do, and can be spilled.
+ */
+struct ring_test {
+	using coeff = uint64_t;
+
+	static coeff zero() {
+		return 0;
+	}
+
+	static bool is_zero(const coeff &c) {
+		return c == 0;
+	}
+
+	static void add(coeff &c, const coeff &d) {
+		c ^= d;
+	}
+
+	static coeff mul(const coeff &c, const coeff &d) {
+		return c & d;
+	}
+};
+
+using test_map = map<uint64_t, uint64_t>;
+
+
+// Random monomial of degree d in the variables of vars
+static uint64_t random_monom(mt19937_64 &gen, const uint64_t &vars, const uint &d) {
+	uint64_t m = 0;
+	while((uint) __builtin_popcountll(m) < d)
+		m |= deposit_monom(((uint64_t) 1) << (gen() % __builtin_popcountll(vars)), vars);
+	return m;
+}
+
+
+/*
+ * Polynomial of n terms of degree min_degree to max_degree in the variables of
+ * target, one term in 20 having an extra variable out of target if out_of_target
+ * is set (as after L4 for a superset of the cube, but not after S5).
+ */
+static test_map random_poly(mt19937_64 &gen, const uint64_t &target, const uint &min_degree, const uint &max_degree, const size_t &n,
+                            const bool &out_of_target) {
+	test_map p;
+	while(p.size() < n) {
+		uint64_t m = random_monom(gen, target, min_degree + gen() % (max_degree - min_degree + 1));
+		if(out_of_target && !(gen() % 20))
+			m |= random_monom(gen, ~target, 1);
+		p[m] = gen() | gen(); // Some coefficients of a product vanish
+	}
+	return p;
+}
+
+
+static void remove_zeros(test_map &p) {
+	erase_if(p, [](const auto &t) {return t.second == 0;});
+}
+
+
+static void check_sort_terms(mt19937_64 &gen) {
+	for(const uint nb_vars: {20, 33, 40}) {
+		uint64_t vars = 0;
+		while((uint) __builtin_popcountll(vars) < nb_vars)
+			vars |= ((uint64_t) 1) << (gen() % 64);
+		for(const size_t n: {0, 100, 10000}) {
+			vector<term_ref<uint64_t>> terms;
+			for(size_t i = 0; i < n; i++)
+				terms.emplace_back(random_monom(gen, vars, gen() % (nb_vars + 1)), nullptr);
+			terms.emplace_back(terms.empty() ? 0 : terms[0].first, nullptr); // A repeated monomial
+			vector<uint64_t> expected;
+			for(const auto &t: terms)
+				expected.push_back(t.first);
+			sort(expected.begin(), expected.end());
+
+			vector<term_ref<uint64_t>> buffer;
+			sort_terms(terms, buffer, vars);
+			vector<uint64_t> sorted;
+			for(const auto &t: terms)
+				sorted.push_back(t.first);
+			check(sorted == expected, "sort_terms of " + to_string(n) + " terms in " + to_string(nb_vars) + " variables");
+		}
+	}
+}
+
+
+static void check_merge_terms(mt19937_64 &gen) {
+	for(const auto &[nb_queries, nb_terms]: vector<pair<size_t, size_t>>{{0, 100}, {100, 0}, {10, 10000}, {10000, 10000}, {10000, 10}}) {
+		// Queries and terms on 16 bits, so that many queries match, some of them repeated
+		vector<poly_term<uint64_t>> terms;
+		set<uint64_t> monoms;
+		while(monoms.size() < nb_terms)
+			monoms.insert(gen() & 0xffff);
+		for(const auto &m: monoms)
+			terms.push_back({m, gen()});
+		vector<uint64_t> coeffs(nb_queries);
+		vector<term_ref<uint64_t>> queries;
+		for(size_t i = 0; i < nb_queries; i++) {
+			coeffs[i] = i;
+			queries.emplace_back(gen() & 0xffff, &coeffs[i]);
+		}
+		sort(queries.begin(), queries.end(), [](const term_ref<uint64_t> &q1, const term_ref<uint64_t> &q2) {return q1.first < q2.first;});
+
+		vector<pair<uint64_t, uint64_t>> expected;
+		for(const auto &[m, coeff1]: queries) {
+			const auto it = lower_bound(terms.begin(), terms.end(), m, [](const poly_term<uint64_t> &t, const uint64_t &x) {return t.monom < x;});
+			if(it != terms.end() && it->monom == m)
+				expected.emplace_back(*coeff1, it->coeff);
+		}
+		vector<pair<uint64_t, uint64_t>> found;
+		merge_terms(queries.data(), queries.data() + queries.size(), span<const poly_term<uint64_t>>(terms),
+		            [&found](const uint64_t &coeff1, const uint64_t &coeff2) {found.emplace_back(coeff1, coeff2);});
+		check(found == expected, "merge_terms of " + to_string(nb_queries) + " queries and " + to_string(nb_terms) + " terms");
+	}
+}
+
+
+// Terms of degree s5_min to s5_max of the product of c1 and c2, in the variables of target
+template<typename S>
+static test_map naive_S5(const test_map &c1, const test_map &c2, const uint64_t &target) {
+	test_map prod;
+	for(const auto &[m1, coeff1]: c1) {
+		for(const auto &[m2, coeff2]: c2) {
+			const uint d = __builtin_popcountll(m1 | m2);
+			if(!((m1 | m2) & ~target) && d >= S::s5_min && d <= S::s5_max)
+				prod[m1 | m2] ^= coeff1 & coeff2;
+		}
+	}
+	remove_zeros(prod);
+	return prod;
+}
+
+
+// Coefficient of target in the product of c1 and c2
+static uint64_t naive_S6(const test_map &c1, const test_map &c2, const uint64_t &target) {
+	uint64_t coeff = 0;
+	for(const auto &[m1, coeff1]: c1) {
+		for(const auto &[m2, coeff2]: c2) {
+			if((m1 | m2) == target)
+				coeff ^= coeff1 & coeff2;
+		}
+	}
+	return coeff;
+}
+
+
+template<typename S>
+static void check_S5(mt19937_64 &gen, const string &name) {
+	const uint64_t target = random_monom(gen, ~((uint64_t) 0), S::target_degree);
+	for(const size_t n: {0, 10, 300}) {
+		const test_map c1 = random_poly(gen, target, S::s5_min / 2 - 1, S::s5_max / 2, n, true);
+		const test_map c2 = random_poly(gen, target, S::s5_min / 2 - 1, S::s5_max / 2, 300, true);
+		const test_map expected = naive_S5<S>(c1, c2, target);
+		const string what = "S5 of " + name + " on " + to_string(n) + " terms";
+
+		test_map prod = multiply_maps_S5<ring_test, S>(c1, c2, target);
+		remove_zeros(prod);
+		check(prod == expected, what);
+
+		// Coordinates after L4 stored, and spilled with a budget of 0
+		for(const size_t limit: {SIZE_MAX, (size_t) 0}) {
+			set_memory_budget(limit, ".");
+			test_map copy1 = c1;
+			test_map copy2 = c2;
+			const stored_poly<uint64_t> s1(std::move(copy1), target);
+			const stored_poly<uint64_t> s2(std::move(copy2), target);
+			prod = multiply_maps_S5<ring_test, S>(s1, s2, target);
+			remove_zeros(prod);
+			check(prod == expected, what + (limit ? ", stored" : ", spilled"));
+		}
+	}
+}
+
+
+template<typename S>
+static void check_S6(mt19937_64 &gen, const string &name) {
+	const uint64_t target = random_monom(gen, ~((uint64_t) 0), S::target_degree);
+	constexpr uint cover_degree = std::max<uint>(S::s5_min, S::target_degree + 1 - S::s5_max);
+
+	// Few terms (sparse) or many (dense), spilled or not
+	uint nb_nonzero = 0;
+	uint nb_dense = 0;
+	for(const size_t n1: {100, 3000}) {
+		for(const size_t n2: {100, 3000}) {
+			const test_map p1 = random_poly(gen, target, S::s5_min, S::s5_max, n1, false);
+			const test_map p2 = random_poly(gen, target, S::s5_min, S::s5_max, n2, false);
+			const uint64_t expected = naive_S6(p1, p2, target);
+			nb_nonzero += (expected != 0);
+			for(const size_t limit: {SIZE_MAX, (size_t) 0}) {
+				set_memory_budget(limit, ".");
+				test_map copy1 = p1;
+				test_map copy2 = p2;
+				const stored_poly<uint64_t> c1(std::move(copy1), target);
+				const stored_poly<uint64_t> c2(std::move(copy2), target);
+				const string what = "S6 of " + name + " on " + to_string(n1) + (c1.is_dense() ? " dense" : (c1.is_spilled() ? " spilled" : " sparse"))
+				                    + " and " + to_string(n2) + (c2.is_dense() ? " dense" : (c2.is_spilled() ? " spilled" : " sparse")) + " terms";
+				nb_dense += c1.is_dense() + c2.is_dense();
+				s6_lookups lookups;
+				check(multiply_maps_S6<ring_test, S>(c1, c2, target, lookups) == expected, what);
+				if constexpr(cover_degree <= S::s5_max) {
+					const covering_index cover1(c1, target, cover_degree, S::s5_max);
+					const covering_index cover2(c2, target, cover_degree, S::s5_max);
+					check(multiply_maps_S6<ring_test, S>(c1, c2, target, lookups, cover1, cover2) == expected, what + ", covering index");
+				}
+			}
+		}
+	}
+	check(nb_nonzero > 0, "S6 of " + name + " gives some nonzero coefficients");
+	check(nb_dense > 0, "S6 of " + name + " reads some dense polynomials");
+}
+
+
+int main() {
+	mt19937_64 gen(2022);
+	check_sort_terms(gen);
+	check_merge_terms(gen);
+	check_S5<cube_schedule<3, 0>>(gen, "phase 2");
+	check_S5<cube_schedule<3, 1>>(gen, "phase 3");
+	check_S6<cube_schedule<3, 0>>(gen, "phase 2");
+	check_S6<cube_schedule<3, 1>>(gen, "phase 3");
+	check(memory_budget().in_memory == 0 && memory_budget().on_disk == 0, "memory budget given back");
+
+	if(nb_failures)
+		return EXIT_FAILURE;
+	cout << "rounds_5_6_test: OK" << endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,84 @@
+/*
+ * Practical cube-attack against nonce-misused ASCON
+ * Filename : sharding_test.cpp
+ * Content : Checks that the first rounds computed by several worker processes
+ *           (see sharding.hpp) match the ones computed by a single process,
+ *           the workers being started once OpenMP threads are running, and
+ *           that no exchanged file is left behind.
+*/
+
+#include <random>
+#include "../l4.hpp"
+
+using namespace std;
+
+// 3 rounds, cubes of 16 variables: small enough for a quick check
+using schedule = cube_schedule<3, 0>;
+
+
+/*
+ * Initial state of phase 2 for a random cube of schedule::target_degree
+ * columns: v_i and a_i in rows 0 and 1 of the cube columns, c_i in rows 3 and 4.
+ */
+static state random_start(mt19937_64 &gen) {
+	set<uint> cube;
+	while(cube.size() < schedule::target_degree)
+		cube.insert(gen() % 64);
+
+	state start;
+	for(uint j = 0; j < 64; j++) {
+		if(cube.count(j)) {
+			monom v = {0, 0, 0, 0, 0};
+			v[0] = ((uint64_t) 1) << (63 - j);
+			start[j].insert(v);
+			monom a = {0, 0, 0, 0, 0};
+			a[1] = ((uint64_t) 1) << (63 - j);
+			start[64 + j].insert(a);
+		}
+		for(uint i = 3; i < 5; i++) {
+			monom c = {0, 0, 0, 0, 0};
+			c[3] = ((uint64_t) 1) << (63 - j);
+			start[i * 64 + j].insert(c);
+		}
+	}
+	return start;
+}
+
+
+int main() {
+	shard_worker_main<schedule>();
+	alarm(600); // A worker which hangs fails the test instead of blocking it
+
+	// The OpenMP threads of this process are running before the workers start
+	omp_set_num_threads(4);
+	mt19937_64 gen(2022);
+	const state start = random_start(gen);
+	const state expected = build_state_l4<schedule>(start, coor_mask().set());
+
+	const layer_masks<schedule> cone = backward_cone<schedule>(coor_mask().set());
+	uint nb_failures = 0;
+	for(const uint nb_workers: {2, 3}) {
+		const state sharded = gather_layers<schedule>(start, cone, cone.size() - 1, nb_workers);
+		for(uint i = 0; i < 320; i++) {
+			if(sharded[i] != expected[i]) {
+				cerr << "FAILED: coordinate " << i << " with " << nb_workers << " workers" << endl;
+				nb_failures++;
+			}
+		}
+	}
+
+	// Without gathering, nothing is written for the calling process to read
+	sharded_layers<schedule>(start, cone, cone.size() - 1, 2);
+	const string prefix = "ascon_shard_" + to_string(getpid()) + "_";
+	for(const auto &entry: filesystem::directory_iterator(exchange_dir())) {
+		if(entry.path().filename().string().rfind(prefix, 0) == 0) {
+			cerr << "FAILED: " << entry.path().string() << " left behind" << endl;
+			nb_failures++;
+		}
+	}
+
+	if(nb_failures)
+		return EXIT_FAILURE;
+	cout << "sharding_test: OK" << endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,109 @@
+/*
+ * Practical cube-attack against nonce-misused ASCON
+ * Filename : trail_table_test.cpp
+ * Content : Checks at compile time that the products and trails derived by
+ *           make_trail_table for row 0 are the ones formerly written by hand
+ *           in rounds_5_6.hpp.
+*/
+
+#include "../rounds_5_6.hpp"
+
+using namespace std;
+
+// Former list_products, sorted
+constexpr array<size_2_products, 22> former_products = {{
+	{0, 1, 2}, {0, 1, 3}, {0, 2, 3}, {0, 3, 4}, {3, 1, 2}, {3, 1, 3}, {3, 2, 3}, {23, 0, 1}, {23, 1, 4}, {25, 1, 2}, {25, 1, 3},
+	{25, 2, 3}, {36, 0, 1}, {36, 1, 2}, {36, 1, 4}, {45, 0, 1}, {45, 1, 2}, {45, 1, 4}, {57, 0, 1}, {57, 1, 4}, {58, 3, 4}, {63, 3, 4}
+}};
+
+// Former list_trails, each trail being given by its two products in no particular order
+constexpr array<array<size_2_products, 2>, 121> former_trails = {{
+	{{{25, 2, 3}, {63, 3, 4}}}, {{{25, 2, 3}, {58, 3, 4}}}, {{{0, 3, 4}, {25, 2, 3}}}, {{{3, 2, 3}, {63, 3, 4}}}, {{{58, 3, 4}, {3, 2, 3}}}, {{{0, 3, 4}, {3, 2, 3}}},
+	{{{0, 2, 3}, {63, 3, 4}}}, {{{0, 2, 3}, {58, 3, 4}}}, {{{57, 1, 4}, {25, 2, 3}}}, {{{57, 1, 4}, {3, 2, 3}}}, {{{0, 2, 3}, {57, 1, 4}}}, {{{25, 2, 3}, {45, 1, 4}}},
+	{{{25, 2, 3}, {45, 1, 2}}}, {{{3, 2, 3}, {45, 1, 4}}}, {{{3, 2, 3}, {45, 1, 2}}}, {{{0, 2, 3}, {45, 1, 4}}}, {{{0, 2, 3}, {45, 1, 2}}}, {{{25, 2, 3}, {36, 1, 4}}},
+	{{{25, 2, 3}, {36, 1, 2}}}, {{{3, 2, 3}, {36, 1, 4}}}, {{{3, 2, 3}, {36, 1, 2}}}, {{{0, 2, 3}, {36, 1, 4}}}, {{{0, 2, 3}, {36, 1, 2}}}, {{{25, 1, 3}, {63, 3, 4}}},
+	{{{25, 1, 3}, {58, 3, 4}}}, {{{0, 3, 4}, {25, 1, 3}}}, {{{25, 1, 2}, {63, 3, 4}}}, {{{25, 1, 2}, {58, 3, 4}}}, {{{0, 3, 4}, {25, 1, 2}}}, {{{25, 1, 3}, {57, 1, 4}}},
+	{{{25, 1, 2}, {57, 1, 4}}}, {{{25, 1, 3}, {45, 1, 4}}}, {{{25, 1, 3}, {45, 1, 2}}}, {{{25, 1, 2}, {45, 1, 4}}}, {{{25, 1, 2}, {45, 1, 2}}}, {{{25, 1, 3}, {36, 1, 4}}},
+	{{{25, 1, 3}, {36, 1, 2}}}, {{{25, 1, 2}, {36, 1, 4}}}, {{{25, 1, 2}, {36, 1, 2}}}, {{{25, 2, 3}, {23, 1, 4}}}, {{{3, 2, 3}, {23, 1, 4}}}, {{{0, 2, 3}, {23, 1, 4}}},
+	{{{25, 1, 3}, {23, 1, 4}}}, {{{25, 1, 2}, {23, 1, 4}}}, {{{3, 1, 3}, {63, 3, 4}}}, {{{58, 3, 4}, {3, 1, 3}}}, {{{0, 3, 4}, {3, 1, 3}}}, {{{3, 1, 2}, {63, 3, 4}}},
+	{{{58, 3, 4}, {3, 1, 2}}}, {{{0, 3, 4}, {3, 1, 2}}}, {{{57, 1, 4}, {3, 1, 3}}}, {{{57, 1, 4}, {3, 1, 2}}}, {{{3, 1, 3}, {45, 1, 4}}}, {{{3, 1, 3}, {45, 1, 2}}},
+	{{{3, 1, 2}, {45, 1, 4}}}, {{{3, 1, 2}, {45, 1, 2}}}, {{{3, 1, 3}, {36, 1, 4}}}, {{{3, 1, 3}, {36, 1, 2}}}, {{{3, 1, 2}, {36, 1, 4}}}, {{{3, 1, 2}, {36, 1, 2}}},
+	{{{3, 1, 3}, {23, 1, 4}}}, {{{3, 1, 2}, {23, 1, 4}}}, {{{0, 1, 3}, {63, 3, 4}}}, {{{0, 1, 3}, {58, 3, 4}}}, {{{0, 1, 2}, {63, 3, 4}}}, {{{0, 1, 2}, {58, 3, 4}}},
+	{{{0, 1, 2}, {0, 3, 4}}}, {{{0, 1, 2}, {25, 2, 3}}}, {{{0, 1, 2}, {3, 2, 3}}}, {{{0, 1, 3}, {57, 1, 4}}}, {{{0, 1, 2}, {57, 1, 4}}}, {{{0, 1, 3}, {45, 1, 4}}},
+	{{{0, 1, 3}, {45, 1, 2}}}, {{{0, 1, 2}, {45, 1, 4}}}, {{{0, 1, 2}, {45, 1, 2}}}, {{{0, 1, 3}, {36, 1, 4}}}, {{{0, 1, 3}, {36, 1, 2}}}, {{{0, 1, 2}, {36, 1, 4}}},
+	{{{0, 1, 2}, {36, 1, 2}}}, {{{0, 1, 2}, {25, 1, 3}}}, {{{0, 1, 2}, {25, 1, 2}}}, {{{0, 1, 3}, {23, 1, 4}}}, {{{0, 1, 2}, {23, 1, 4}}}, {{{0, 1, 2}, {3, 1, 3}}},
+	{{{0, 1, 2}, {3, 1, 2}}}, {{{57, 0, 1}, {25, 2, 3}}}, {{{57, 0, 1}, {3, 2, 3}}}, {{{0, 2, 3}, {57, 0, 1}}}, {{{57, 0, 1}, {25, 1, 3}}}, {{{57, 0, 1}, {25, 1, 2}}},
+	{{{57, 0, 1}, {3, 1, 3}}}, {{{57, 0, 1}, {3, 1, 2}}}, {{{0, 1, 3}, {57, 0, 1}}}, {{{0, 1, 2}, {57, 0, 1}}}, {{{25, 2, 3}, {45, 0, 1}}}, {{{3, 2, 3}, {45, 0, 1}}},
+	{{{0, 2, 3}, {45, 0, 1}}}, {{{25, 1, 3}, {45, 0, 1}}}, {{{25, 1, 2}, {45, 0, 1}}}, {{{3, 1, 3}, {45, 0, 1}}}, {{{3, 1, 2}, {45, 0, 1}}}, {{{0, 1, 3}, {45, 0, 1}}},
+	{{{0, 1, 2}, {45, 0, 1}}}, {{{25, 2, 3}, {36, 0, 1}}}, {{{3, 2, 3}, {36, 0, 1}}}, {{{0, 2, 3}, {36, 0, 1}}}, {{{25, 1, 3}, {36, 0, 1}}}, {{{25, 1, 2}, {36, 0, 1}}},
+	{{{3, 1, 3}, {36, 0, 1}}}, {{{3, 1, 2}, {36, 0, 1}}}, {{{0, 1, 3}, {36, 0, 1}}}, {{{0, 1, 2}, {36, 0, 1}}}, {{{25, 2, 3}, {23, 0, 1}}}, {{{3, 2, 3}, {23, 0, 1}}},
+	{{{0, 2, 3}, {23, 0, 1}}}, {{{25, 1, 3}, {23, 0, 1}}}, {{{25, 1, 2}, {23, 0, 1}}}, {{{3, 1, 3}, {23, 0, 1}}}, {{{3, 1, 2}, {23, 0, 1}}}, {{{0, 1, 3}, {23, 0, 1}}},
+	{{{0, 1, 2}, {23, 0, 1}}}
+}};
+
+// Former list_generic_products
+constexpr array<generic_size_2_products, 6> former_generic_products = {{{0, 1}, {1, 2}, {1, 3}, {1, 4}, {2, 3}, {3, 4}}};
+
+
+constexpr bool same_products(const trail_table &t) {
+	if(t.nb_products != former_products.size())
+		return false;
+	for(uint k = 0; k < former_products.size(); k++) {
+		if(t.products[k] != former_products[k])
+			return false;
+	}
+	return true;
+}
+
+
+// Each former trail is a trail of t and conversely, the trails of t being distinct
+constexpr bool same_trails(const trail_table &t) {
+	if(t.nb_trails != former_trails.size())
+		return false;
+	for(uint k = 1; k < t.nb_trails; k++) {
+		if(!(t.pairs[k - 1] < t.pairs[k]))
+			return false;
+	}
+	const auto same_trail = [&t](const uint &k, const array<size_2_products, 2> &p) {
+		const size_2_products &q1 = t.products[t.pairs[k].first];
+		const size_2_products &q2 = t.products[t.pairs[k].second];
+		return (q1 == p[0] && q2 == p[1]) || (q1 == p[1] && q2 == p[0]);
+	};
+	for(const auto &p: former_trails) {
+		bool found = false;
+		for(uint k = 0; k < t.nb_trails; k++)
+			found = found || same_trail(k, p);
+		if(!found)
+			return false;
+	}
+	for(uint k = 0; k < t.nb_trails; k++) {
+		bool found = false;
+		for(const auto &p: former_trails)
+			found = found || same_trail(k, p);
+		if(!found)
+			return false;
+	}
+	return true;
+}
+
+
+constexpr bool same_generic_products(const trail_table &t) {
+	if(t.nb_generic_products != former_generic_products.size())
+		return false;
+	for(uint k = 0; k < former_generic_products.size(); k++) {
+		if(t.generic_products[k] != former_generic_products[k])
+			return false;
+	}
+	return true;
+}
+
+
+static_assert(same_products(trail_tables[0]), "products of size 2 leading to row 0");
+static_assert(same_trails(trail_tables[0]), "trails of size 4 leading to row 0");
+static_assert(same_generic_products(trail_tables[0]), "generic products leading to row 0");
+
+
+int main() {
+	cout << "trail_table_test: OK" << endl;
+	return EXIT_SUCCESS;
+}
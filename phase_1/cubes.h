@@ -0,0 +1,18 @@
+/*
+ * Filename : cubes.h
+ * Content : The two cubes x^v and x^w introduced in our paper, shared by the
+ *           statistical and the symbolic verifications of the first phase.
+*/
+#ifndef CUBES_H
+#define CUBES_H
+
+#include <vector>
+
+// 0 stands for cube x^v from our paper, any other integer for cube x^w.
+inline const std::vector<unsigned int> &phase_1_cube(const unsigned int &cube_index) {
+	static const std::vector<unsigned int> cube_v = {0, 1, 4, 5, 6, 8, 14, 15, 16, 26, 27, 30, 34, 37, 38, 48, 49, 50, 56, 58, 59, 60, 63, 17, 35, 40, 46, 55, 9, 12, 18, 19};
+	static const std::vector<unsigned int> cube_w = {0, 1, 4, 5, 6, 8, 14, 15, 16, 26, 27, 30, 34, 37, 38, 48, 49, 50, 56, 58, 59, 60, 63, 17, 35, 40, 46, 55, 7, 24, 41, 43};
+	return (cube_index == 0) ? cube_v : cube_w;
+}
+
+#endif /* CUBES_H */
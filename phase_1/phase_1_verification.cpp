@@ -4,7 +4,7 @@
  * Author : Jules Baudrin
  * Content : Main file for the verification of the first phase.
 */
-#include "cube_computation.h"
+#include "phase_1_verification.h"
 
 using namespace std;
 using namespace std::chrono;
@@ -34,11 +34,7 @@ int main(int argc, char *argv[]){
 	const string header = argv[1];
 	const uint cube_index = stoi(argv[2]);
 
-	vector<uint> cube;
-	if(cube_index == 0)
-		cube = {0, 1, 4, 5, 6, 8, 14, 15, 16, 26, 27, 30, 34, 37, 38, 48, 49, 50, 56, 58, 59, 60, 63, 17, 35, 40, 46, 55, 9, 12, 18, 19};
-	else
-		cube = {0, 1, 4, 5, 6, 8, 14, 15, 16, 26, 27, 30, 34, 37, 38, 48, 49, 50, 56, 58, 59, 60, 63, 17, 35, 40, 46, 55, 7, 24, 41, 43};
+	const vector<uint> &cube = phase_1_cube(cube_index);
 
 	/*
 	 * For "nb_tries" random capacities, the cube-sum corresponding to x^v or x^w
@@ -12,6 +12,7 @@
 #include <chrono>
 #include "cube_sum.h"
 #include "random.h"
+#include "cubes.h"
 #include <omp.h>
 
 #endif /* CUBE_COMPUTATION_H */
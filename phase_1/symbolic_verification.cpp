@@ -0,0 +1,133 @@
+/*
+ * Filename : symbolic_verification.cpp
+ * Content : Main file for the symbolic verification of the first phase. The
+ *           coefficients of the cubes x^v and x^w are computed exactly by the
+ *           ANF engine (see ../anf_engine) with the capacity rows kept
+ *           symbolic, instead of being sampled by cube-sums over random inner
+ *           states.
+*/
+#include <fstream>
+#include <chrono>
+#include "cubes.h"
+#include "../anf_engine/rounds_5_6.hpp"
+#include "../anf_engine/rings.hpp"
+
+using namespace std;
+using namespace std::chrono;
+
+// Monomials of degree 32 after S6, the first 4 rounds being computed on the
+// symbolic state. Their coefficients are polynomials in a and e.
+using schedule = cube_schedule<4, 0>;
+using product_poly = layered_poly<ring_anf::coeff>;
+
+
+/*
+ * Returns the initial state of a cube: v_i in row 0, and symbolic a_i and e_i
+ * in the columns of the cube.
+ * Only the terms of degree 1 in v_i after S1 reach the targeted degree, and
+ * their coefficients are a_i + 1, 1, 0, c_i + d_i + 1 = e_i and a_i on rows 0
+ * to 4: b, c and the round constants can be set to 0 (d = e + 1) without
+ * changing the coefficients of the cube, which only depend on a and e.
+ */
+state initialize_state(const vector<uint> &cube) {
+	state start;
+	for(const auto &j: cube) {
+		const uint64_t bit = ((uint64_t) 1) << (63 - j);
+		start[j] = {{bit, 0, 0, 0, 0}}; // v
+		start[64 + j] = {{0, bit, 0, 0, 0}}; // a
+		start[256 + j] = {{0, 0, 0, 0, bit}, {0, 0, 0, 0, 0}}; // d = e + 1
+	}
+	return start;
+}
+
+
+/*
+ * Returns c in which the variable of word w (1 for a, ..., 4 for e) and
+ * column j is replaced by value.
+ */
+ring_anf::coeff substitute(const ring_anf::coeff &c, const uint &w, const uint &j, const bool &value) {
+	const uint64_t bit = ((uint64_t) 1) << (63 - j);
+	ring_anf::coeff s;
+	for(monom m: c) {
+		if(m[w] & bit) {
+			if(!value)
+				continue;
+			m[w] ^= bit;
+		}
+		ring_anf::add_monom(s, m);
+	}
+	return s;
+}
+
+
+/*
+ * Computes the 64 coefficients of the cube x^v or x^w on row 0 after S6 (the
+ * last linear layer is omitted) as polynomials in a and e.
+ * The program takes as input the same two parameters as phase_1_verification:
+ * - a header for the result file which will be named
+ *   {header}_symbolic_cube_{0,1}.txt, and contains one coefficient per line.
+ * - the index corresponding to the cube (0 for x^v, any other integer for x^w).
+ * For each value of the most significant bits of a and e, the number of
+ * coefficients which do not vanish is then reported: the statistical
+ * verification expects all of them to vanish for a single pair of values.
+ * The results are stored in a folder called "results" (PLEASE CREATE THE FOLDER BEFORE)
+ */
+int main(int argc, char *argv[]){
+	if(argc != 3)
+		return 1;
+
+	omp_set_num_threads(8);
+	const string header = argv[1];
+	const uint cube_index = stoi(argv[2]);
+	const vector<uint> &cube = phase_1_cube(cube_index);
+
+	uint64_t target = 0;
+	for(const auto &j: cube)
+		target |= ((uint64_t) 1) << (63 - j);
+
+	auto start = high_resolution_clock::now();
+
+	// As in phase 2, the coordinates after L4 are only computed when a column
+	// needs them, l3 and s4 being kept compressed.
+	lazy_l4_in<ring_anf> lazy = init_lazy_l4<ring_anf>(initialize_state(cube), 1);
+	array<ring_anf::coeff, 64> coefficients;
+	ofstream f("results/" + header + "_symbolic_cube_" + to_string(cube_index) + ".txt");
+	for(uint i = 0; i < 64; i++) {
+		require_l4<ring_anf, schedule>(lazy, l4_needed_for_columns({i}));
+		coefficients[i] = coefficient_recovery<ring_anf, schedule, product_poly>(i, lazy.l4, target);
+		f << ring_anf::to_txt(coefficients[i]) << endl;
+	}
+	f.close();
+
+	auto stop = high_resolution_clock::now();
+	cout << "Time: " << duration_cast<seconds>(stop - start).count() << endl;
+
+	// Variables the coefficients depend on
+	monom vars = {0, 0, 0, 0, 0};
+	for(const auto &c: coefficients) {
+		for(const auto &m: c) {
+			for(uint w = 1; w < 5; w++)
+				vars[w] |= m[w];
+		}
+	}
+	cout << "Variables:";
+	const array<string, 5> names = {"v", "a", "b", "c", "e"};
+	for(uint w = 1; w < 5; w++) {
+		for(uint j = 0; j < 64; j++) {
+			if((vars[w] >> (63 - j)) & 1)
+				cout << " " << names[w] << j;
+		}
+	}
+	cout << endl;
+
+	// Quick overview, as in phase_1_verification
+	for(uint a = 0; a < 2; a++) {
+		for(uint e = 0; e < 2; e++) {
+			uint w = 0;
+			for(const auto &c: coefficients)
+				w += !ring_anf::is_zero(substitute(substitute(c, 1, 0, a), 4, 0, e));
+			cout << "a: " << a << " | e: " << e << " | non-zero coefficients: " << w << (w ? "" : " (vanishes)") << endl;
+		}
+	}
+	return 0;
+}
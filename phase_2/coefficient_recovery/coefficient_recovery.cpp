@@ -4,8 +4,9 @@
  * Date : May 2022
  * Author : Jules Baudrin
  * Content : Contains the main function for the recovery of coefficients of
- * degree-32 monomials after the sixth S-box layer under the assumption that all
- * the bits of e and about half the bits of a are already recovered.
+ * degree-32 monomials after the sixth S-box layer (target_degree after the
+ * S-box layer following the symbolic rounds in general) under the assumption
+ * that all the bits of e and about half the bits of a are already recovered.
 */
 
 #include "coefficient_recovery.hpp"
@@ -32,7 +33,7 @@ using namespace chrono;
 set<uint> select_cube(uint *nb_unknowns, uint64_t *target, uint64_t a, uint64_t e, set<uint> &list_e_0, set<uint> &list_e_1, set<uint> &list_a_recovered){
 	set<uint> cube;
 	*target = (uint64_t) 0; // Maks corresponding to cubes
-	const uint nb_zeros = 29; // CAN BE MODIFIED
+	const uint nb_zeros = min<uint>(29, target_degree - 3); // CAN BE MODIFIED, nb_zeros < target_degree
 
 	// Choice of cube : at least one var v_i such that e_i = 1, as many v_i as possible such that e_i = 0
 	if(list_e_0.size() > nb_zeros) { // add a random subset of size nb_zeros
@@ -46,7 +47,7 @@ set<uint> select_cube(uint *nb_unknowns, uint64_t *target, uint64_t a, uint64_t
 		cout << "NB_ZEROS == " << list_e_0.size() << endl;
 	}
 
-	while(cube.size() != 32) {// Add at least one var v_i such that e_i = 1, more if necessary
+	while(cube.size() != target_degree) {// Add at least one var v_i such that e_i = 1, more if necessary
 		uint r = random_monom() % list_e_1.size();
 		uint tmp_index = *next(list_e_1.begin(), r);
 		if(!list_a_recovered.count(tmp_index)) {
@@ -124,9 +125,24 @@ state initialize_state(const set<uint> &cube, const set<uint> &list_a,
 }
 
 int main() {
+	shard_worker_main(); // Never returns in the workers of the first rounds (see nb_workers)
 	omp_set_num_threads(8);
+	print_trail_tables();
 	uint max_tries = 15;
 
+	// Folder in which the coordinates after L4 are cached between runs and
+	// tries (empty to disable the cache).
+	const string l4_cache_dir = "results/l4_cache"; // CAN BE MODIFIED
+
+	// Number of processes sharing the computation of the first rounds, each one
+	// holding only its share of the columns.
+	const uint nb_workers = 1; // CAN BE MODIFIED
+
+	// Number of output columns computed at once. More columns keep more threads
+	// busy, but hold the products of size 2 of all of them, and may compute
+	// columns which are not needed once enough equations are found.
+	const uint nb_concurrent_columns = 4; // CAN BE MODIFIED
+
 	//STEP 0 : Initialization of capacity rows a & e
 	set<uint> list_a; // List of i such that a_i = 1
 	set<uint> list_e_1; // List of i such that e_i = 1
@@ -161,39 +177,58 @@ int main() {
 
 		/*
 		* STEP 1: For each cube, initialize a state with:
-        *          - the necessary variables (all b_i, all c_i, and 31 v_i)
+        *          - the necessary variables (all b_i, all c_i, and target_degree v_i)
 		*          - the values of a_i and e_i
 		*/
 		state start = initialize_state(cube, list_a, list_e_0, list_a_recovered_1);
 
-		// STEP 2: Compute all the terms of deg 8 after L4
-		const array<poly_map , 320> l4 = get_l4(start);
-
-		// STEP 3: Compute the coefficients of the targeted cube of degree 32 after S6.
+		// STEP 2: Compute all the terms of deg 8 after L3. The terms after L4
+		// are only computed when a column needs them, as the loop below
+		// usually stops before the last column. Those computed by a previous
+		// run or try from the same state are read from the cache.
+		lazy_l4 lazy = init_lazy_l4(start, nb_workers);
+		const coor_mask cached = load_l4(lazy, l4_cache_dir);
+
+		// STEP 3: Compute the coefficients of the targeted cube of degree target_degree after S6.
+		// The products of size 2 after S5 are shared between the columns, and
+		// released once the columns which need them are done. The columns are
+		// computed nb_concurrent_columns at a time, their products and trails
+		// sharing the threads, and written in column order.
+		set<uint> columns;
+		for(uint i = 0; i < 64; i++)
+			columns.insert(i);
+		s5_table products = init_s5_table(columns);
 		uint count_non_constant = 0;
-		for(int i = 0; i < 64; i++) {
-			string s = coefficient_recovery(i, l4, target);
-
-			ofstream f;
-			if(i)
-				f.open("results/polynomials.txt",fstream::out | fstream::app);
-			else
-				f.open("results/polynomials.txt");
-			f << s << endl;
-			f.close();
-
-			if(s != "0" && s != "1")
-				count_non_constant++;
-
-			// Automatic stop if the number of non-constant equations is twice
-			// the number of unknowns
-			if(count_non_constant > (2 * nb_unknowns))
-				break;
+		bool enough = false;
+		for(uint first = 0; first < 64 && !enough; first += nb_concurrent_columns) {
+			vector<uint> window;
+			for(uint i = first; i < min<uint>(64, first + nb_concurrent_columns); i++)
+				window.push_back(i);
+			require_l4(lazy, l4_needed_for_columns(set<uint>(window.begin(), window.end())));
+			coefficient_recovery(window, lazy.l4, target, products, [&](const uint &i, const string &s) {
+				ofstream f;
+				if(i)
+					f.open("results/polynomials.txt",fstream::out | fstream::app);
+				else
+					f.open("results/polynomials.txt");
+				f << s << endl;
+				f.close();
+
+				if(s != "0" && s != "1")
+					count_non_constant++;
+
+				// Automatic stop if the number of non-constant equations is twice
+				// the number of unknowns: the columns still running are cancelled
+				enough = count_non_constant > (2 * nb_unknowns);
+				return !enough;
+			});
 		}
+		if(lazy.l4_done != cached)
+			save_l4(lazy, l4_cache_dir);
 
 		// STEP 4 : Compute the corresponding cube-sum
 		cout << "values recovery..." << endl;
-		cube_sum_given_cubes_given_a_e("results/parameters.txt", "results/cube_sum_vectors.txt");
+		cube_sum_given_cubes_given_a_e("results/parameters.txt", "results/cube_sum_vectors.txt", nb_rounds + 2);
 
 		// STEP 5 : From the polynomials and the values, build the system and
 		// solve it.
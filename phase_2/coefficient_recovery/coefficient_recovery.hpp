@@ -12,6 +12,7 @@
 #define COEFFICIENT_RECOVERY_HPP
 
 #include "rounds_5_6.hpp"
+#include "l4_cache.hpp"
 #include "../values_recovery/values_recovery.h"
 
 #endif //COEFFICIENT_RECOVERY_HPP
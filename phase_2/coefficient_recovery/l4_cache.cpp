@@ -0,0 +1,168 @@
+/*
+ * Practical cube-attack against nonce-misused ASCON
+ * Filename : l4_cache.cpp
+ * Content : Persistent cache of the coordinates after L4.
+ *
+ * File format (native endianness):
+ *  - a header (see l4_cache_header),
+ *  - the initial state serialized with pack_coor followed by the number of
+ *    rounds computed on the symbolic state, which is compared on reading to
+ *    rule out hash collisions,
+ *  - the cached coordinates. Each one is the number of terms, then for each
+ *    term (in increasing order) the difference between its monomial in v_i and
+ *    the previous one, and its coefficient compressed by pack_coor.
+ *
+ * Contrary to phase 3, the coefficients are sets of monomials in a, b and c
+ * which cannot be used in place: the file is memory-mapped, so that processes
+ * reading the same file share its pages, and the coordinates are decoded.
+*/
+
+#include "l4_cache.hpp"
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+#include <iomanip>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+// "L4CACHE2" read as a little-endian word, identifies the format and the phase
+const uint64_t l4_cache_magic = 0x324548434143344cULL;
+
+struct l4_cache_header {
+	uint64_t magic;
+	uint64_t key; // hash of the serialized initial state
+	uint64_t start_bytes; // size of the serialized initial state
+	uint64_t done[5]; // bit i is set if coordinate i is cached
+	uint64_t offsets[321]; // coordinate i is made of the bytes offsets[i] to offsets[i + 1] - 1
+};
+
+
+// Identifies the cached coordinates: the initial state, and the number of
+// rounds after which they are taken
+packed_coor serialize_start(const state &start) {
+	packed_coor bytes = serialize_state(start);
+	put_varint(bytes, nb_rounds);
+	return bytes;
+}
+
+
+const string l4_cache_path(const string &dir, const uint64_t &key) {
+	stringstream name;
+	name << dir << "/l4_" << hex << setw(16) << setfill('0') << key << ".bin";
+	return name.str();
+}
+
+
+/*
+ * Reads the coordinates cached for lazy.start in the cache folder dir into
+ * lazy.l4, and marks them in lazy.l4_done.
+ * Returns the cached coordinates (none if the file is missing, truncated or
+ * computed from another initial state).
+ */
+coor_mask load_l4(lazy_l4 &lazy, const string &dir) {
+	if(dir.empty())
+		return coor_mask();
+	const packed_coor start_bytes = serialize_start(lazy.start);
+	const uint64_t key = state_key(start_bytes, l4_cache_magic);
+	const string path = l4_cache_path(dir, key);
+
+	const int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0)
+		return coor_mask();
+	struct stat st;
+	const size_t size = (fstat(fd, &st) < 0) ? 0 : st.st_size;
+	void *addr = (size < sizeof(l4_cache_header)) ? MAP_FAILED : mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(addr == MAP_FAILED)
+		return coor_mask();
+
+	const l4_cache_header *header = (const l4_cache_header *) addr;
+	const uint8_t *start = ((const uint8_t *) addr) + sizeof(l4_cache_header);
+	const uint8_t *body = start + start_bytes.size();
+	coor_mask cached;
+	if(header->magic == l4_cache_magic && header->key == key && header->start_bytes == start_bytes.size()
+	   && size >= sizeof(l4_cache_header) + start_bytes.size() + header->offsets[320]
+	   && !memcmp(start, start_bytes.data(), start_bytes.size())) {
+		for(uint i = 0; i < 320; i++)
+			cached[i] = (header->done[i / 64] >> (i % 64)) & 1;
+
+#pragma omp parallel for default(none) shared(lazy, cached, header, body) schedule(dynamic, 1)
+		for(uint i = 0; i < 320; i++) {
+			if(cached[i] && !lazy.l4_done[i]) {
+				const uint8_t *it = body + header->offsets[i];
+				const uint64_t nb_terms = get_varint(it);
+				uint64_t monom = 0;
+				lazy.l4[i].clear();
+				for(uint64_t t = 0; t < nb_terms; t++) {
+					monom += get_varint(it);
+					lazy.l4[i].emplace_hint(lazy.l4[i].end(), monom, unpack_coor(it));
+				}
+			}
+		}
+		lazy.l4_done |= cached;
+		cout << "L4 read from cache " + path + " (" + to_string(cached.count()) + "/320)\n";
+	}
+	munmap(addr, size);
+	return cached;
+}
+
+
+/*
+ * Writes the coordinates of lazy.l4 computed so far to the cache folder dir.
+ * The file is written under a temporary name and renamed once complete, so
+ * that other processes never read a partial file.
+ */
+void save_l4(const lazy_l4 &lazy, const string &dir) {
+	if(dir.empty())
+		return;
+	error_code ec;
+	filesystem::create_directories(dir, ec);
+	const packed_coor start_bytes = serialize_start(lazy.start);
+	const uint64_t key = state_key(start_bytes, l4_cache_magic);
+	const string path = l4_cache_path(dir, key);
+
+	l4_cache_header header = {};
+	header.magic = l4_cache_magic;
+	header.key = key;
+	header.start_bytes = start_bytes.size();
+	array<packed_coor, 320> coors;
+#pragma omp parallel for default(none) shared(lazy, coors) schedule(dynamic, 1)
+	for(uint i = 0; i < 320; i++) {
+		if(lazy.l4_done[i]) {
+			put_varint(coors[i], lazy.l4[i].size());
+			uint64_t prev = 0;
+			for(const auto &[monom, coeff]: lazy.l4[i]) {
+				put_varint(coors[i], monom - prev);
+				const packed_coor p = pack_coor(coeff);
+				coors[i].insert(coors[i].end(), p.begin(), p.end());
+				prev = monom;
+			}
+		}
+	}
+	for(uint i = 0; i < 320; i++) {
+		if(lazy.l4_done[i])
+			header.done[i / 64] |= ((uint64_t) 1) << (i % 64);
+		header.offsets[i + 1] = header.offsets[i] + coors[i].size();
+	}
+
+	const string tmp = path + ".tmp" + to_string(getpid());
+	ofstream f(tmp, ios::binary);
+	f.write((const char *) &header, sizeof(header));
+	f.write((const char *) start_bytes.data(), start_bytes.size());
+	for(const auto &c: coors)
+		f.write((const char *) c.data(), c.size());
+	f.close();
+
+	if(!f.fail())
+		filesystem::rename(tmp, path, ec);
+	if(f.fail() || ec) {
+		filesystem::remove(tmp, ec);
+		cout << "L4 cannot be cached in " + dir + "\n";
+	}
+	else
+		cout << "L4 written to cache " + path + " (" + to_string(lazy.l4_done.count()) + "/320)\n";
+}
@@ -0,0 +1,17 @@
+/*
+ * Practical cube-attack against nonce-misused ASCON
+ * Filename : l4_cache.hpp
+ * Content : Persistent cache of the coordinates after L4. Each file is named
+ *           after a hash of the initial state it was computed from, and holds
+ *           the coordinates after L4 computed so far for this state.
+*/
+
+#ifndef L4_CACHE_HPP
+#define L4_CACHE_HPP
+
+#include "rounds_1_to_4.hpp"
+
+coor_mask load_l4(lazy_l4 &lazy, const std::string &dir);
+void save_l4(const lazy_l4 &lazy, const std::string &dir);
+
+#endif /* L4_CACHE_HPP */
@@ -3,9 +3,11 @@
  * Filename : rounds_1_to_4.hpp
  * Date : May 2022
  * Author : Jules Baudrin
- * Content : All the functions needed to compute THE FIRST 4 ROUNDS of ASCON
+ * Content : All the functions needed to compute THE FIRST ROUNDS of ASCON (4 by default)
  *           The computation is not exhaustive, it only computes the part of the
  *           ANF which is needed.
+ *           The layers are those of the ANF engine (see anf_engine/), with the
+ *           coefficients and the degree schedule of phase 2.
 */
 
 #ifndef ROUNDS_1_TO_4_HPP
@@ -13,24 +15,29 @@
 
 #include <iostream>
 #include <fstream>
-#include <set>
-#include <array>
-#include <omp.h>
-#include <vector>
-#include <algorithm>
-#include <map>
-
-using monom = std::array<uint64_t, 5>;
-using coor = std::set<monom>;
-using state = std::array<coor, 320>;
-using uint = unsigned int;
-
-using poly_map = std::map<uint64_t, coor>;
-
-const coor add_coor(const coor &c1, const coor &c2);
-const coor mult_coor(const coor &c1, const coor &c2, const std::function<bool(const monom&)> &condition_mult);
-const state build_state_l4(const state&);
-const std::array<poly_map, 320> get_l4(const state &start);
-const std::array<poly_map, 128> get_l5(const state &);
+#include "../../anf_engine/l4.hpp"
+#include "../../anf_engine/rings.hpp"
+
+// polynomial whose variables are v_i and coefficients are polynomials in a_i
+using poly_map = poly_map_in<ring_a>;
+
+// Number of rounds computed on the symbolic state, the attack covers 1.5 more
+// rounds plus the linear last one: 4 for the 6-round attack
+inline constexpr uint nb_rounds = 4; // CAN BE MODIFIED
+
+// Degrees in v_i kept by phase 2: only the highest-degree terms, whose
+// coefficients are polynomials in a_i only (see cube_schedule)
+using schedule = cube_schedule<nb_rounds, 0>;
+
+// Degree of the target monomials, i.e. size of the cubes
+inline constexpr uint target_degree = schedule::target_degree;
+
+using lazy_l4 = lazy_l4_in<ring_a>;
+
+void shard_worker_main();
+const layer_masks<schedule> backward_cone(const coor_mask &l4_needed);
+std::array<poly_map, 320> get_l4(const state &start, const coor_mask &l4_needed = coor_mask().set(), const uint &nb_workers = 1);
+lazy_l4 init_lazy_l4(const state &start, const uint &nb_workers = 1);
+void require_l4(lazy_l4 &lazy, const coor_mask &l4_needed);
 
 #endif /* ROUNDS_1_TO_4_HPP */
@@ -16,12 +16,20 @@
 #include <fstream>
 #include <chrono>
 #include <random>
+#include <functional>
 #include "rounds_1_to_4.hpp"
+#include "../../anf_engine/rounds_5_6.hpp"
 
-using size_2_products = std::array<uint, 3>;
-using generic_size_2_products = std::tuple<uint, uint>;
-using trails = std::pair<size_2_products, size_2_products>;
+// product of size 2 after S5, stored densely when it is dense enough
+using product_poly = layered_poly<poly_map::mapped_type>;
 
+// products of size 2 after S5 shared between the output columns
+using s5_table = product_table<product_poly>;
+
+s5_table init_s5_table(const std::set<uint> &cols);
 const std::string coefficient_recovery(const uint &col, const std::array<poly_map, 320> &l4, const uint64_t &target);
+const std::string coefficient_recovery(const uint &col, const std::array<poly_map, 320> &l4, const uint64_t &target, s5_table &table);
+uint coefficient_recovery(const std::vector<uint> &cols, const std::array<poly_map, 320> &l4, const uint64_t &target, s5_table &table,
+                          const std::function<bool(const uint &, const std::string &)> &on_polynomial);
 
 #endif /* ROUNDS_5_6_HPP */
@@ -33,9 +33,10 @@ uint64_t random_monom() {
  *  2- then, computes the cube-sum vector corresponding to the cube stored
  *  in the input file;
  *  3- and finally, outputs a file containing the cube-sum vector.
+ * The cube-sum is taken after "rounds" rounds, i.e. the symbolic rounds of
+ * coefficient_recovery plus 2.
  */
-void cube_sum_given_cubes_given_a_e(const string &inputfilename, const string &outputfilename){
-	uint rounds = 6;
+void cube_sum_given_cubes_given_a_e(const string &inputfilename, const string &outputfilename, const uint &rounds){
 	bool last_lin = false;
 	bool cst = false;
 
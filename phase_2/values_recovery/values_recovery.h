@@ -18,7 +18,7 @@
 
 #include "cube_sum.h"
 
-void cube_sum_given_cubes_given_a_e(const std::string &inputfilename, const std::string &outputfilename);
+void cube_sum_given_cubes_given_a_e(const std::string &inputfilename, const std::string &outputfilename, const uint &rounds = 6);
 uint64_t random_monom();
 
 #endif /* VALUES_RECOVERY_H */
@@ -4,8 +4,9 @@
  * Date : May 2022
  * Author : Jules Baudrin
  * Content : Contains the main function for the recovery of coefficients of
- * degree-31 monomials after the sixth S-box layer under the assumption that
- * vectors a and e are already fully-recovered.
+ * degree-31 monomials after the sixth S-box layer (target_degree after the
+ * S-box layer following the symbolic rounds in general) under the assumption
+ * that vectors a and e are already fully-recovered.
 */
 
 #include "coefficient_recovery.hpp"
@@ -69,7 +70,26 @@ const state initialize_state(set<uint> cube, set<uint> list_a, set<uint> list_e_
 
 
 int main() {
+	shard_worker_main(); // Never returns in the workers of the first rounds (see nb_workers)
 	omp_set_num_threads(8);
+	print_trail_tables();
+
+	// Memory (in bytes) allowed for the coordinates after L4 and the products after S5.
+	// Beyond it, they are spilled to memory-mapped files in the results folder.
+	const size_t memory_limit = ((size_t) 64) << 30; // CAN BE MODIFIED
+	set_memory_budget(memory_limit, "../results");
+
+	// Memory (in bytes) allowed for the products of size 2 after S5. The output
+	// columns are processed by windows whose products fit in it, the products
+	// shared by consecutive windows being kept (SIZE_MAX: all the columns at once).
+	const size_t products_budget = ((size_t) 32) << 30; // CAN BE MODIFIED
+
+	// Folder in which the coordinates after L4 are cached between runs (empty to disable the cache).
+	const string l4_cache_dir = "../results/l4_cache"; // CAN BE MODIFIED
+
+	// Number of processes sharing the computation of the first 4 rounds, each one
+	// holding only its share of the columns.
+	const uint nb_workers = 1; // CAN BE MODIFIED
 
 	// Random a, e with uniformly distributed a_i, e_i bits
 	set<uint> list_a; // List of i such that a_i = 1
@@ -95,24 +115,40 @@ int main() {
 	 * Build random cubes made as follows:
 	 * Add ``as much v_i as possible such that e_i = 0'' while assuring a minimal
 	 * number of v_i such that e_i = 1
+	 * The cubes are the sub-cubes of a random superset of one more variable,
+	 * each one without a distinct v_i such that e_i = 1: the coordinates after
+	 * L4 are only computed once, for the superset.
 	 */
 	const uint nb_cubes = 3;
 	array <set<uint>, nb_cubes> cubes; // cubes as lists of integers
-	array <uint64_t, nb_cubes> targets; // cubes as binary masks
-	const uint nb_zeros = 28; // maximum number of v_i such that e_i = 0. nb_zeros < 30
-	for(uint i = 0; i < nb_cubes; i++) {
-		// As much v_i as possible such that e_i = 0 while respecting the max nb.
-		if(list_e_0.size() > nb_zeros) {
-			while(cubes[i].size() != nb_zeros) {
-				cubes[i].insert(*next(list_e_0.begin(), random_monom() % list_e_0.size()));
-			}
+	array <uint64_t, nb_cubes> targets = {}; // cubes as binary masks
+	const uint nb_zeros = min<uint>(28, target_degree - 3); // maximum number of v_i such that e_i = 0. nb_zeros < target_degree + 2 - nb_cubes
+	set<uint> superset_cube; // superset as a list of integers
+	uint64_t superset = 0; // superset as a binary mask
+
+	// As much v_i as possible such that e_i = 0 while respecting the max nb.
+	if(list_e_0.size() > nb_zeros) {
+		while(superset_cube.size() != nb_zeros) {
+			superset_cube.insert(*next(list_e_0.begin(), random_monom() % list_e_0.size()));
 		}
-		else
-			cubes[i].insert(list_e_0.begin(), list_e_0.end());
+	}
+	else
+		superset_cube.insert(list_e_0.begin(), list_e_0.end());
+
+	// Add at least nb_cubes vars v_i such that e_i = 1, more if necessary
+	set<uint> superset_e_1;
+	while(superset_cube.size() != target_degree + 1) {
+		const uint x = *next(list_e_1.begin(), random_monom() % list_e_1.size());
+		superset_cube.insert(x);
+		superset_e_1.insert(x);
+	}
+	for(auto &x: superset_cube)
+		superset |= ((uint64_t) 1) << (63 - x);
 
-		// Add at least one var v_i such that e_i = 1, more if necessary
-		while(cubes[i].size() != 31)
-			cubes[i].insert(*next(list_e_1.begin(), random_monom() % list_e_1.size()));
+	// Remove a distinct v_i such that e_i = 1 from each cube
+	for(uint i = 0; i < nb_cubes; i++) {
+		cubes[i] = superset_cube;
+		cubes[i].erase(*next(superset_e_1.begin(), i));
 
 		// Fill the mask
 		for(auto &x: cubes[i])
@@ -143,34 +179,39 @@ int main() {
 	}
 	parameters.close();
 
-	for(uint k = 0; k < nb_cubes; k++) {
-		/*
-		 * STEP 1: For each cube, initialize a state with:
-		 *          - the necessary variables (all b_i, all c_i, and 31 v_i)
-		 *          - the values of a_i and e_i
-		*/
-		const state start = initialize_state(cubes[k], list_a, list_e_0);
+	/*
+	 * STEP 1: Initialize a state with:
+	 *          - the necessary variables (all b_i, all c_i, and the target_degree + 1 v_i of the superset)
+	 *          - the values of a_i and e_i
+	 */
+	const state start = initialize_state(superset_cube, list_a, list_e_0);
 
-		// STEP 2: Compute all the terms of deg 7 or 8 after L4
-		const array<poly_map, 320 > l4 = get_l4(start);
+	// STEP 2: Compute all the terms of deg 7 or 8 after L4 for the superset, or read them from the cache
+	const stored_l4 superset_l4 = cached_l4(start, superset, l4_cache_dir, nb_workers);
 
-		// STEP 3: Compute the coefficients of the targeted cube of degree 31 after S6.
-		auto start_step3 = high_resolution_clock::now();
+	for(uint k = 0; k < nb_cubes; k++) {
+		// The terms after L4 of the cube are those of the superset without the
+		// removed variable: S5 skips the other ones while reading superset_l4
+		const stored_l4 &l4 = superset_l4;
 
-		// FOR LIMITED MEMORY USAGE : compute the coefficients one by one
-		for(int i = 0; i < 64; ++i) {
-			const auto start_col = high_resolution_clock::now();
-			cout << "Col" + to_string(i) + "..." << endl;
-			ofstream f("../results/polynomials_cube_" + to_string(k) + ".txt", fstream::out | fstream::app);
-			f << coefficient_recovery(i, l4, targets[k]);
-			f.close();
-			const auto stop_col = high_resolution_clock::now();
-			const auto duration_col = duration_cast<seconds>(stop_col - start_col);
-			cout << k << ", col" << i << " done in " + to_string(duration_col.count()) + "secs" << endl;
-		}
+		// STEP 3: Compute the coefficients of the targeted cube of degree target_degree after S6.
+		auto start_step3 = high_resolution_clock::now();
 
-		// FOR ENVIRONMENT NOT LIMITED BY MEMORY : compute all the coefficients in parallel
-		// coefficient_recovery_all_polys(l4, targets[k], "../results/polynomials_cube_" + to_string(k) + ".txt");
+		// Compute all the coefficients in parallel, by windows of columns under
+		// products_budget. Whatever does not fit in the memory budget is spilled to disk.
+		coefficient_recovery_all_polys(l4, targets[k], "../results/polynomials_cube_" + to_string(k) + ".txt", products_budget);
+
+		// ALTERNATIVELY : compute the coefficients one by one
+		// for(uint i = 0; i < 64; ++i) {
+		// 	const auto start_col = high_resolution_clock::now();
+		// 	cout << "Col" + to_string(i) + "..." << endl;
+		// 	ofstream f("../results/polynomials_cube_" + to_string(k) + ".txt", fstream::out | fstream::app);
+		// 	f << coefficient_recovery(i, l4, targets[k]);
+		// 	f.close();
+		// 	const auto stop_col = high_resolution_clock::now();
+		// 	const auto duration_col = duration_cast<seconds>(stop_col - start_col);
+		// 	cout << k << ", col" << i << " done in " + to_string(duration_col.count()) + "secs" << endl;
+		// }
 
 		auto stop_step3 = high_resolution_clock::now();
 		auto duration_step3 = duration_cast<seconds>(stop_step3 - start_step3);
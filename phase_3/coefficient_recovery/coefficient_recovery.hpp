@@ -11,5 +11,6 @@
 #define COEFFICIENT_RECOVERY_HPP
 
 #include "rounds_5_6.hpp"
+#include "l4_cache.hpp"
 
 #endif // COEFFICIENT_RECOVERY_HPP
@@ -0,0 +1,162 @@
+/*
+ * Practical cube-attack against nonce-misused ASCON
+ * Filename : l4_cache.cpp
+ * Content : Persistent cache of the coordinates after L4.
+ *
+ * File format (native endianness, 8-byte aligned):
+ *  - a header (see l4_cache_header),
+ *  - the initial state serialized with pack_coor followed by the number of
+ *    rounds computed on the symbolic state, padded to 8 bytes, which is
+ *    compared on reading to rule out hash collisions,
+ *  - the terms {monomial, coefficient} of the 320 coordinates, each coordinate
+ *    being sorted by monomial as expected by stored_poly.
+*/
+
+#include "l4_cache.hpp"
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+#include <iomanip>
+#include <unistd.h>
+
+using namespace std;
+
+// "L4CACHE3" read as a little-endian word, identifies the format and the phase
+const uint64_t l4_cache_magic = 0x334548434143344cULL;
+
+struct l4_cache_header {
+	uint64_t magic;
+	uint64_t key; // hash of the serialized initial state
+	uint64_t start_bytes; // size of the serialized initial state
+	uint64_t offsets[321]; // coordinate i is made of the terms offsets[i] to offsets[i + 1] - 1
+};
+
+using cached_term = l4_poly::term;
+static_assert(sizeof(cached_term) == sizeof(uint64_t) + sizeof(coefficient), "terms are written without padding");
+
+
+size_t padded(const size_t &n) {
+	return (n + 7) & ~((size_t) 7);
+}
+
+
+// Identifies the cached coordinates: the initial state, and the number of
+// rounds after which they are taken
+packed_coor serialize_start(const state &start) {
+	packed_coor bytes = serialize_state(start);
+	put_varint(bytes, nb_rounds);
+	return bytes;
+}
+
+
+/*
+ * Maps the cache file path and points the coordinates of l4 to its terms.
+ * Returns false if the file is missing, truncated, corrupted (offsets which
+ * do not split the terms into 320 coordinates) or computed from another
+ * initial state.
+ */
+bool read_l4_cache(const string &path, const packed_coor &start_bytes, const uint64_t &key, stored_l4 &l4) {
+	size_t size = 0;
+	const mapped_file file = map_file(path, size);
+	if(!file || size < sizeof(l4_cache_header) + padded(start_bytes.size()))
+		return false;
+
+	const l4_cache_header *header = (const l4_cache_header *) file.get();
+	const uint8_t *start = ((const uint8_t *) file.get()) + sizeof(l4_cache_header);
+	const cached_term *terms = (const cached_term *) (start + padded(start_bytes.size()));
+	if(header->magic != l4_cache_magic || header->key != key || header->start_bytes != start_bytes.size())
+		return false;
+
+	// The offsets count terms: the terms must fill the rest of the file, and each coordinate
+	// must start where the previous one ends
+	const size_t terms_bytes = size - sizeof(l4_cache_header) - padded(start_bytes.size());
+	if(terms_bytes % sizeof(cached_term) || header->offsets[0] != 0 || header->offsets[320] != terms_bytes / sizeof(cached_term))
+		return false;
+	for(uint i = 0; i < 320; i++) {
+		if(header->offsets[i] > header->offsets[i + 1])
+			return false;
+	}
+	if(memcmp(start, start_bytes.data(), start_bytes.size()))
+		return false;
+
+	for(uint i = 0; i < 320; i++)
+		l4[i] = l4_poly(file, terms + header->offsets[i], header->offsets[i + 1] - header->offsets[i]);
+	return true;
+}
+
+
+/*
+ * Writes l4 to the cache file path. The file is written under a temporary
+ * name and renamed once complete, so that other processes never read a
+ * partial file.
+ */
+bool write_l4_cache(const string &path, const packed_coor &start_bytes, const uint64_t &key, const array<poly_map, 320> &l4) {
+	l4_cache_header header = {};
+	header.magic = l4_cache_magic;
+	header.key = key;
+	header.start_bytes = start_bytes.size();
+	for(uint i = 0; i < 320; i++)
+		header.offsets[i + 1] = header.offsets[i] + l4[i].size();
+
+	const string tmp = path + ".tmp" + to_string(getpid());
+	ofstream f(tmp, ios::binary);
+	f.write((const char *) &header, sizeof(header));
+	f.write((const char *) start_bytes.data(), start_bytes.size());
+	const uint64_t zero = 0;
+	f.write((const char *) &zero, padded(start_bytes.size()) - start_bytes.size());
+	for(const auto &c: l4) {
+		for(const auto &[monom, coeff]: c) {
+			const cached_term t = {monom, coeff};
+			f.write((const char *) &t, sizeof(t));
+		}
+	}
+	f.close();
+
+	error_code ec;
+	if(!f.fail())
+		filesystem::rename(tmp, path, ec);
+	if(f.fail() || ec) {
+		filesystem::remove(tmp, ec);
+		return false;
+	}
+	return true;
+}
+
+
+/*
+ * Returns the coordinates after L4 computed from start, as get_l4 followed by
+ * store_l4 would, but reads them from the cache folder dir when they were
+ * already computed by a previous run. Otherwise they are computed and written
+ * to the cache.
+ * Either way the coordinates are then views on the mapped cache file: they use
+ * no heap memory, and processes working on the same initial state share the
+ * same physical pages.
+ * An empty dir disables the cache, as coefficients which cannot be used in
+ * place (see ring_anf) do. nb_workers is passed to get_l4.
+ */
+stored_l4 cached_l4(const state &start, const uint64_t &target, const string &dir, const uint &nb_workers) {
+	if(dir.empty() || !l4_poly::spillable)
+		return store_l4(get_l4(start, coor_mask().set(), nb_workers), target);
+
+	error_code ec;
+	filesystem::create_directories(dir, ec);
+	const packed_coor start_bytes = serialize_start(start);
+	const uint64_t key = state_key(start_bytes, l4_cache_magic);
+	stringstream name;
+	name << dir << "/l4_" << hex << setw(16) << setfill('0') << key << ".bin";
+	const string path = name.str();
+
+	stored_l4 l4;
+	if(read_l4_cache(path, start_bytes, key, l4)) {
+		cout << "L4 read from cache " + path + "\n";
+		return l4;
+	}
+
+	array<poly_map, 320> computed = get_l4(start, coor_mask().set(), nb_workers);
+	if(write_l4_cache(path, start_bytes, key, computed) && read_l4_cache(path, start_bytes, key, l4)) {
+		cout << "L4 written to cache " + path + "\n";
+		return l4;
+	}
+	cout << "L4 cannot be cached in " + dir + "\n";
+	return store_l4(move(computed), target);
+}
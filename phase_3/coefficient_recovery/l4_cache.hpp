@@ -0,0 +1,17 @@
+/*
+ * Practical cube-attack against nonce-misused ASCON
+ * Filename : l4_cache.hpp
+ * Content : Persistent cache of the coordinates after L4. Each file is named
+ *           after a hash of the initial state it was computed from, and holds
+ *           the terms of the 320 coordinates as sorted arrays which are used
+ *           in place once the file is memory-mapped.
+*/
+
+#ifndef L4_CACHE_HPP
+#define L4_CACHE_HPP
+
+#include "rounds_5_6.hpp"
+
+stored_l4 cached_l4(const state &start, const uint64_t &target, const std::string &dir, const uint &nb_workers = 1);
+
+#endif /* L4_CACHE_HPP */
@@ -3,258 +3,41 @@
  * Filename : rounds_1_to_4.cpp
  * Date : May 2022
  * Author : Jules Baudrin
- * Content : All the functions needed to compute THE FIRST 4 ROUNDS of ASCON
+ * Content : All the functions needed to compute THE FIRST ROUNDS of ASCON (4 by default)
  *           The computation is not exhaustive, it only computes the part of the
  *           ANF which is needed.
+ *           The ANF engine is instantiated here for phase 3.
 */
 
 #include "rounds_1_to_4.hpp"
 
 using namespace std;
 
-/*
- * For each row of the state s, prints the average length of a coordinate
- */
-void print_len(const state &s, const string &name) {
-	cout << name << " avg: ";
-	for(uint i = 0; i < 5; i++) {
-		uint mean = 0;
-		for(uint j = 0; j < 64; j++) {
-			mean += s[i * 64 + j].size();
-		}
-		cout << to_string(static_cast<int>(((float) mean) / 64)) + " | ";
-	}
-	cout << endl;
+// Runs the job of a worker of the sharded computation if this process is one (see sharding.hpp)
+void shard_worker_main() {
+	shard_worker_main<schedule>();
 }
 
 
-/*
- *  Returns the addition of two coordinates.
- */
-const coor add_coor(const coor &c1, const coor &c2) {
-	coor c;
-	set_symmetric_difference(c1.begin(), c1.end(), c2.begin(), c2.end(),
-							 std::inserter(c, c.begin()));
-	return c;
+const layer_masks<schedule> backward_cone(const coor_mask &l4_needed) {
+	return backward_cone<schedule>(l4_needed);
 }
 
 
 /*
- * Returns the product of a monomial/monomial multiplication
+ * Returns the state after the last linear layer of the first rounds as an array of poly_map
+ * from a given initial state (see compute_l4).
  */
-const monom mult_monom(const monom &m1, const monom &m2) {
-	monom m = {0, 0, 0, 0, 0};
-	for(uint i = 0; i < 5; i++)
-		m[i] = m1[i] | m2[i];
-	return m;
+array<poly_map, 320> get_l4(const state &start, const coor_mask &l4_needed, const uint &nb_workers) {
+	return compute_l4<ring, schedule>(start, l4_needed, nb_workers);
 }
 
 
-/*
- * Returns the product of a coordinate/coordinate multiplication.
- * The parameter condition_mult is a function  f: monomial -> Boolean
- * It is used to filter the resulting product: once the product of two monomials
- * is computed, we check if it is interesting or not for the next steps
- * (i.e. f(m1*m2) = true/false). All products of present monomials are computed
- *  during the multiplication of coordinates BUT only the interesting ones are
- *  stored in the resulting product.
- */
-const coor mult_coor(const coor &c1, const coor &c2,
-					 const function<bool(const monom &)> &condition_mult) {
-	coor c;
-	for(const auto &x: c1) {
-		for(const auto &y: c2) {
-			const monom m = mult_monom(x, y);
-			if(condition_mult(m)) {
-				// Handles the XOR cancellation if the monomial is already present.
-				if(c.contains(m))
-					c.erase(m);
-				else
-					c.insert(m);
-			}
-		}
-	}
-	return c;
-}
-
-/*
- * Returns true if the degree in public variable of monomial m is in the set of
- * degree degs.
- * This function is used to filter some multiplications of coordinates.
- */
-bool cond_degree(const monom &m, const set<uint> &degs) {
-	return degs.contains((uint) __builtin_popcountll(m[0]));
-}
-
-
-/*
- * ASCON Sbox function.
- * Input coordinates : x0 to x4
- * Output coordinates: y0 to y4
- * The Boolean parameter "quadrqtic" is used to indicate whether we need to
- * compute the whole Sbox layer or only the quadratic terms of the Sbox.
- * condition_mult is used to filter the resulting multiplications of coordinates.
- */
-void sbox(const coor &x0, const coor &x1, const coor &x2, const coor &x3,
-		  const coor &x4, coor &y0, coor &y1, coor &y2, coor &y3, coor &y4,
-		  const bool &quadratic, const function<bool(const monom &)> &condition_mult) {
-	const coor x2x1 = mult_coor(x2, x1, condition_mult);
-	y2 = mult_coor(x4, x3, condition_mult);
-	y3 = mult_coor(x0, add_coor(x3, x4), condition_mult);
-	y4 = mult_coor(x1, add_coor(x4, x0), condition_mult);
-	y1 = add_coor(mult_coor(add_coor(x2, x1), x3, condition_mult), x2x1);
-	y0 = add_coor(x2x1, y4);
-
-	if(!quadratic) {
-		const coor x0_x1_x2_x3 = add_coor(add_coor(add_coor(x0, x1), x2), x3);
-		const coor const_one = {{0,0,0,0,0}};
-		y0 = add_coor(y0, x0_x1_x2_x3);
-		y1 = add_coor(add_coor(y1, x0_x1_x2_x3), x4);
-		y2 = add_coor(add_coor(add_coor(y2, x1), add_coor(x2, const_one)), x4);
-		y3 = add_coor(add_coor(y3, x0_x1_x2_x3), x4);
-		y4 = add_coor(add_coor(add_coor(y4, x1), x3), x4);
-
-	}
-}
-
-
-/*
- * Returns the new state after applying the Sbox to the 64 columns of the state.
- */
-const state sbox_state(const state &s, const bool &quadratic,
-					   const function<bool(const monom &)> &condition_mult) {
-	state new_state;
-
-#pragma omp parallel for default(none) shared(s, new_state, std::cout, quadratic, condition_mult)
-	for(uint i = 0; i < 64; i++) {
-		sbox(s[i], s[i + 64], s[i + 128], s[i + 192], s[i + 256],
-			 new_state[i], new_state[i + 64], new_state[i + 128],
-			 new_state[i + 192], new_state[i + 256], quadratic, condition_mult);
-	}
-	return new_state;
-}
-
-
-/*
- * ASCON linear layer
- */
-const state lin_layer(const state &s) {
-	state new_state;
-	const uint shifts[10] = {45, 36, 3, 25, 63, 58, 54, 47, 57, 23};
-
-#pragma omp parallel for default(none) shared(s, new_state, shifts, std::cout)
-	for(int j = 0; j < 64; j++) {
-		for(int i = 0; i < 5; i++) {
-			const uint cur = (i * 64) + j;
-			new_state[cur] = add_coor(add_coor(s[cur], s[(i * 64) + ((j + shifts[i * 2]) % 64)]),
-			                        s[(i * 64) + ((j + shifts[(i * 2) + 1]) % 64)]);
-		}
-	}
-	return new_state;
+lazy_l4 init_lazy_l4(const state &start, const uint &nb_workers) {
+	return init_lazy_l4<ring>(start, nb_workers);
 }
 
 
-/*
- * Converts a coordinate seen as a set of monomials into a polynomial whose
- * variables are v_i and coefficients are polynomials in 1, bi*ci, bi, ci.
- * This corresponds to a usual F[x,y] = F[x][y] isomorphism.
- */
-const poly_map convert_coor_to_poly_map(const coor &c) {
-	map <uint64_t, coefficient> m;
-
-	for(auto &x: c) {
-		const uint64_t cur_monom = x[0];
-		if(!m.contains(cur_monom))
-			m[cur_monom] = {(uint64_t) 0, (uint64_t) 0, (uint64_t) 0, (uint64_t) 0};
-
-		if(x[2] && x[3])
-			m[cur_monom][1] ^= x[2]; // b_i*c_i
-		else if(x[2])
-			m[cur_monom][2] ^= x[2]; // b_i
-		else if(x[3])
-			m[cur_monom][3] ^= x[3]; // c_i
-		else
-			m[cur_monom][0] ^= ((uint64_t) 1); // 1
-	}
-	return m;
-}
-
-
-/*
- * Converts the state into an array of poly_maps
- */
-const array<poly_map, 320> convert_l4(const state &l4) {
-	cout << "conversion..." << endl;
-
-	array<poly_map, 320> l4_converted;
-#pragma omp parallel for default(none) shared(l4_converted, l4, std::cout)
-	for(uint i = 0; i < 320; i++) {
-		l4_converted[i] = convert_coor_to_poly_map(l4[i]);
-		cout << "|" << flush;
-	}
-	cout << endl;
-
-	cout << "l4_converted avg: ";
-	for(uint i = 0; i < 5; i++) {
-		uint mean = 0;
-		for(uint j = 0; j < 64; j++) {
-			mean += l4_converted[i * 64 + j].size();
-		}
-		cout << to_string(static_cast<int>(((float) mean) / 64)) + " | ";
-	}
-	cout << endl;
-
-	return l4_converted;
-}
-
-
-/*
- * Returns the state after the fourth linear layer from a given initial state.
- */
-const state build_state_l4(const state &start) {
-
-	// Filter function : does not filter anything
-	const function<bool(const monom &)> f_s1 = [](const monom &m) { return true; };
-	const state s1 = sbox_state(start, false, f_s1); // true Sbox
-	print_len(s1, "s1");
-	const state l1 = lin_layer(s1);
-	print_len(l1, "l1");
-
-
-	const set<uint> deg_s2 = {1, 2};
-	// Filter function : only product of degree 1 and 2
-	const function<bool(const monom &)> f_s2 = [deg_s2](const monom &m) { return cond_degree(m, deg_s2); };
-	// BEWARE, for sub-leading terms, true Sboxes are needed for round 1 AND 2!
-	// This is because terms of degree 1 after S2 can be obtained through the linear part of S.
-	const state s2 = sbox_state(l1, false, f_s2); // true Sbox
-	print_len(s2, "s2");
-	const state l2 = lin_layer(s2);
-	print_len(l2, "l2");
-
-	const set<uint> deg_s3 = {3, 4};
-	// Filter function : only product of degree 3 and 4
-	const function<bool(const monom &)> f_s3 = [deg_s3](const monom &m) { return cond_degree(m, deg_s3); };
-	const state s3 = sbox_state(l2, true, f_s3); // quadratic Sbox
-	print_len(s3, "s3");
-	const state l3 = lin_layer(s3);
-	print_len(l3, "l3");
-
-	const set<uint> deg_s4 = {7, 8};
-	// Filter function : only product of degree 7 and 8
-	const function<bool(const monom &)> f_s4 = [deg_s4](const monom &m) { return cond_degree(m, deg_s4); };
-	const state s4 = sbox_state(l3, true, f_s4); // quadratic Sbox
-	print_len(s4, "s4");
-	const state l4 = lin_layer(s4);
-	print_len(l4, "l4");
-
-	return l4;
-}
-
-
-/*
- * Returns the state after the fourth linear layer as an array of poly_map
- * from a given initial state.
- */
-const array<poly_map, 320> get_l4(const state &start) {
-	return convert_l4(build_state_l4(start));
+void require_l4(lazy_l4 &lazy, const coor_mask &l4_needed) {
+	require_l4<ring, schedule>(lazy, l4_needed);
 }
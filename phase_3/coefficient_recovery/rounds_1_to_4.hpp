@@ -3,9 +3,11 @@
  * Filename : rounds_1_to_4.hpp
  * Date : May 2022
  * Author : Jules Baudrin
- * Content : All the functions needed to compute THE FIRST 4 ROUNDS of ASCON
+ * Content : All the functions needed to compute THE FIRST ROUNDS of ASCON (4 by default)
  *           The computation is not exhaustive, it only computes the part of the
  *           ANF which is needed.
+ *           The layers are those of the ANF engine (see anf_engine/), with the
+ *           coefficients and the degree schedule of phase 3.
 */
 
 #ifndef ROUNDS_1_TO_4_HPP
@@ -13,31 +15,40 @@
 
 #include <iostream>
 #include <fstream>
-#include <set>
-#include <array>
-#include <omp.h>
-#include <vector>
-#include <algorithm>
-#include <map>
-
-// a monomial represented as a boolean vector of size 320
-using monom = std::array<uint64_t, 5>;
-
-// a coordinate is seen as a set of monomials
-using coor = std::set<monom>;
-
-// ASCON state made of 320 coordinates
-using state = std::array<coor, 320>;
-
-using uint = unsigned int;
-
-// polynomial whose monomials can only be 1, bi*ci, bi, ci
-using coefficient = std::array<uint64_t, 4>;
-// polynomial whose variables are v_i and coefficients are polynomials in 1, bi*ci, bi, ci.
-using poly_map = std::map<uint64_t, coefficient>;
-
-const coor add_coor(const coor &c1, const coor &c2);
-const coor mult_coor(const coor &c1, const coor &c2, const std::function<bool(const monom&)> &condition_mult);
-const std::array<poly_map, 320> get_l4(const state &);
+#include "../../anf_engine/l4.hpp"
+#include "../../anf_engine/rings.hpp"
+
+// Number of rounds computed on the symbolic state, the attack covers 1.5 more
+// rounds plus the linear last one: 4 for the 6-round attack
+inline constexpr uint nb_rounds = 4; // CAN BE MODIFIED
+
+// Difference between the degree of the target monomials and the highest degree
+// 2^(nb_rounds + 1): 1 targets the sub-leading terms (degree 31 in the 6-round
+// attack), each additional unit halves the online cube-sum for more symbolic work
+inline constexpr uint degree_drop = 1; // CAN BE MODIFIED, 1 <= degree_drop < 2^(nb_rounds - 1)
+
+// Degrees in v_i kept by phase 3: the highest-degree and sub-leading terms (see cube_schedule)
+// BEWARE, for sub-leading terms, true Sboxes are needed for round 1 AND 2!
+// This is because terms of degree 1 after S2 can be obtained through the linear part of S.
+using schedule = cube_schedule<nb_rounds, degree_drop>;
+
+// Degree of the target monomials, i.e. size of the cubes
+inline constexpr uint target_degree = schedule::target_degree;
+
+// Coefficients of the polynomials in v_i: the monomials can only be 1, bi*ci,
+// bi, ci for the sub-leading terms, while lower-degree terms need general
+// polynomials in bi, ci
+using ring = std::conditional_t<(degree_drop <= 1), ring_bc, ring_anf>;
+using coefficient = ring::coeff;
+// polynomial whose variables are v_i and coefficients are polynomials in bi, ci
+using poly_map = poly_map_in<ring>;
+
+using lazy_l4 = lazy_l4_in<ring>;
+
+void shard_worker_main();
+const layer_masks<schedule> backward_cone(const coor_mask &l4_needed);
+std::array<poly_map, 320> get_l4(const state &, const coor_mask &l4_needed = coor_mask().set(), const uint &nb_workers = 1);
+lazy_l4 init_lazy_l4(const state &start, const uint &nb_workers = 1);
+void require_l4(lazy_l4 &lazy, const coor_mask &l4_needed);
 
 #endif /* ROUNDS_1_TO_4_HPP */
@@ -17,12 +17,17 @@
 #include <chrono>
 #include <random>
 #include "rounds_1_to_4.hpp"
+#include "../../anf_engine/rounds_5_6.hpp"
+#include "../../anf_engine/spill.hpp"
 
-using size_2_products = std::array<uint, 3>;
-using generic_size_2_products = std::tuple<uint, uint>;
-using trails = std::pair<size_2_products, size_2_products>;
+// coordinate after L4 or product of size 2 after S5, stored densely when it is
+// dense enough, and spilled to disk when it exceeds the memory budget
+using l4_poly = stored_poly<poly_map::mapped_type>;
+using product_poly = stored_poly<poly_map::mapped_type>;
+using stored_l4 = std::array<l4_poly, 320>;
 
-const std::string coefficient_recovery(const uint &col, const std::array<poly_map, 320> &l4, const uint64_t &target);
-void coefficient_recovery_all_polys(const std::array<poly_map, 320> &l4, const uint64_t &target, const std::string &filename);
+stored_l4 store_l4(std::array<poly_map, 320> &&l4, const uint64_t &target);
+const std::string coefficient_recovery(const uint &col, const stored_l4 &l4, const uint64_t &target);
+void coefficient_recovery_all_polys(const stored_l4 &l4, const uint64_t &target, const std::string &filename, const size_t &budget = SIZE_MAX);
 
 #endif // ROUNDS_5_6_HPP
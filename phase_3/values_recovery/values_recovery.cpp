@@ -48,7 +48,7 @@ uint xor_values(vector<uint> values){
  *  as well as the cube-sum vectors.
  */
 void cube_sum_given_cubes_given_a_e(const string &inputfilename, const string &outputfilename){
-	uint rounds = 6;
+	uint rounds = 6; // CAN BE MODIFIED, nb_rounds + 2 of coefficient_recovery
 	bool last_lin = false;
 	bool cst = false;
 